@@ -0,0 +1,27 @@
+#!/bin/sh
+#
+# Compare two qom-bench reports and print the per-phase and total speedup
+# of the second one over the first one.
+#
+# Usage: compare.sh baseline.txt optimized.txt
+
+if [ $# -ne 2 ]; then
+    echo "usage: $0 baseline.txt optimized.txt" >&2
+    exit 1
+fi
+
+awk '
+    FNR == NR && / ns$/ { base[$1] = $2; order[n++] = $1; next }
+    / ns$/ { opt[$1] = $2 }
+    END {
+        printf "%-12s %14s %14s %8s\n", "phase", "baseline ns", "optimized ns",
+               "speedup"
+        for (i = 0; i < n; i++) {
+            p = order[i]
+            if (opt[p] > 0) {
+                printf "%-12s %14d %14d %7.2fx\n", p, base[p], opt[p],
+                       base[p] / opt[p]
+            }
+        }
+    }
+' "$1" "$2"
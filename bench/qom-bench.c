@@ -0,0 +1,328 @@
+/*
+ * QOM benchmark workload
+ *
+ * Exercises the hot paths of the object model: type registration,
+ * class initialization, instantiation and destruction, dynamic casts,
+ * virtual method dispatch, property access and class lookups.  It is the training
+ * workload of the `make pgo` pipeline, and prints the time spent in
+ * each phase so builds can be compared.
+ *
+ * Usage: qom-bench [iterations [type-image]]
+ *
+ * With a type image path, registration binds to the image, which is
+ * (re)written first if it cannot be loaded.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../qom/object.h"
+#include "../qom/type_image.h"
+
+#define TYPE_BENCH_NODE  "bench-node"
+#define TYPE_BENCH_IFACE "bench-iface"
+
+#define BENCH_NUM_TYPES  256
+#define BENCH_MAX_DEPTH  8
+#define BENCH_LIVE       64
+
+typedef struct BenchNode {
+    Object parent;
+
+    unsigned long value;
+} BenchNode;
+
+typedef struct BenchNodeClass {
+    ObjectClass parent_class;
+
+    unsigned long (*visit)(BenchNode *node);
+} BenchNodeClass;
+
+typedef struct BenchIfaceClass {
+    InterfaceClass parent_class;
+} BenchIfaceClass;
+
+#define BENCH_NODE(obj) \
+        OBJECT_CHECK(BenchNode, obj, TYPE_BENCH_NODE)
+
+#define BENCH_NODE_CLASS(klass) \
+        OBJECT_CLASS_CHECK(BenchNodeClass, klass, TYPE_BENCH_NODE)
+
+#define BENCH_NODE_GET_CLASS(obj) \
+        OBJECT_GET_CLASS(BenchNodeClass, obj, TYPE_BENCH_NODE)
+
+static char type_names[BENCH_NUM_TYPES][32];
+
+static unsigned long bench_node_visit(BenchNode *node)
+{
+    return node->value;
+}
+
+static unsigned long bench_leaf_visit(BenchNode *node)
+{
+    return node->value * 2;
+}
+
+static void bench_node_instance_init(Object *obj)
+{
+    BENCH_NODE(obj)->value = 1;
+}
+
+static void bench_leaf_instance_init(Object *obj)
+{
+    BENCH_NODE(obj)->value++;
+}
+
+static void bench_node_class_init(ObjectClass *oc, void *data)
+{
+    BENCH_NODE_CLASS(oc)->visit = bench_node_visit;
+}
+
+static void bench_leaf_class_init(ObjectClass *oc, void *data)
+{
+    BenchNodeClass *nc = BENCH_NODE_CLASS(oc);
+
+    if (data) {
+        nc->visit = bench_leaf_visit;
+    }
+}
+
+static InterfaceInfo bench_ifaces[] = {
+    { TYPE_BENCH_IFACE },
+    { }
+};
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Types form BENCH_NUM_TYPES / BENCH_MAX_DEPTH chains below
+ * TYPE_BENCH_NODE; every third type implements TYPE_BENCH_IFACE.
+ */
+static void bench_register(void)
+{
+    static const TypeInfo iface_info = {
+        .name = TYPE_BENCH_IFACE,
+        .parent = TYPE_INTERFACE,
+        .class_size = sizeof(BenchIfaceClass),
+    };
+    static const TypeInfo node_info = {
+        .name = TYPE_BENCH_NODE,
+        .parent = TYPE_OBJECT,
+        .instance_size = sizeof(BenchNode),
+        .instance_init = bench_node_instance_init,
+        .class_size = sizeof(BenchNodeClass),
+        .class_init = bench_node_class_init,
+    };
+    int i;
+
+    type_register_static(&iface_info);
+    type_register_static(&node_info);
+
+    for (i = 0; i < BENCH_NUM_TYPES; i++) {
+        TypeInfo info = {
+            .name = type_names[i],
+            .instance_init = bench_leaf_instance_init,
+            .class_init = bench_leaf_class_init,
+            .class_data = (i % 2) ? type_names[i] : NULL,
+            .interfaces = (i % 3) ? NULL : bench_ifaces,
+        };
+
+        snprintf(type_names[i], sizeof(type_names[i]), "bench-type-%d", i);
+        info.parent = (i % BENCH_MAX_DEPTH) ? type_names[i - 1]
+                                            : TYPE_BENCH_NODE;
+        type_register(&info);
+    }
+}
+
+static unsigned long bench_lifecycle(long iterations)
+{
+    Object *live[BENCH_LIVE] = { NULL };
+    unsigned long sum = 0;
+    long i;
+
+    for (i = 0; i < iterations; i++) {
+        int slot = i % BENCH_LIVE;
+
+        object_unref(live[slot]);
+        live[slot] = object_new(type_names[i % BENCH_NUM_TYPES]);
+        sum += BENCH_NODE(live[slot])->value;
+    }
+
+    for (i = 0; i < BENCH_LIVE; i++) {
+        object_unref(live[i]);
+    }
+
+    return sum;
+}
+
+static unsigned long bench_casts(Object **objs, long iterations)
+{
+    unsigned long hits = 0;
+    long i;
+
+    for (i = 0; i < iterations; i++) {
+        Object *obj = objs[i % BENCH_NUM_TYPES];
+        ObjectClass *oc = object_get_class(obj);
+
+        hits += object_dynamic_cast(obj, TYPE_BENCH_NODE) != NULL;
+        hits += object_dynamic_cast(obj, type_names[(i * 7) % BENCH_NUM_TYPES])
+                != NULL;
+        hits += object_class_dynamic_cast(oc, TYPE_BENCH_IFACE) != NULL;
+        hits += BENCH_NODE(obj)->value != 0;
+    }
+
+    return hits;
+}
+
+static unsigned long bench_dispatch(Object **objs, long iterations)
+{
+    unsigned long sum = 0;
+    long i;
+
+    for (i = 0; i < iterations; i++) {
+        Object *obj = objs[i % BENCH_NUM_TYPES];
+
+        sum += BENCH_NODE_GET_CLASS(obj)->visit(BENCH_NODE(obj));
+    }
+
+    return sum;
+}
+
+/*
+ * Every object links to another one through its "peer" property.  The
+ * loop reads the links and retargets one every BENCH_LIVE iterations.
+ */
+static unsigned long bench_properties(Object **objs, long iterations)
+{
+    unsigned long sum = 0;
+    long i;
+
+    for (i = 0; i < BENCH_NUM_TYPES; i++) {
+        object_property_add_link(objs[i], "peer",
+                                 objs[(i + 1) % BENCH_NUM_TYPES],
+                                 &error_abort);
+    }
+
+    for (i = 0; i < iterations; i++) {
+        Object *obj = objs[i % BENCH_NUM_TYPES];
+        Object *peer = object_resolve_path_component(obj, "peer");
+
+        sum += BENCH_NODE(peer)->value;
+        if (i % BENCH_LIVE == 0) {
+            object_property_del(obj, "peer");
+            object_property_add_link(obj, "peer",
+                                     objs[(i * 7) % BENCH_NUM_TYPES],
+                                     &error_abort);
+        }
+    }
+
+    for (i = 0; i < BENCH_NUM_TYPES; i++) {
+        object_property_del(objs[i], "peer");
+    }
+
+    return sum;
+}
+
+static unsigned long bench_lookup(long iterations)
+{
+    unsigned long found = 0;
+    long i;
+
+    for (i = 0; i < iterations; i++) {
+        ObjectClass *oc = object_class_by_name(type_names[i % BENCH_NUM_TYPES]);
+
+        found += object_class_get_parent(oc) != NULL;
+        found += is_compatible_type(object_class_get_name(oc),
+                                    TYPE_BENCH_NODE);
+    }
+
+    for (i = 0; i < iterations / 1000 + 1; i++) {
+        GSList *list = object_class_get_list(TYPE_BENCH_IFACE, false);
+
+        found += g_slist_length(list);
+        g_slist_free(list);
+    }
+
+    return found;
+}
+
+int main(int argc, char **argv)
+{
+    Object *objs[BENCH_NUM_TYPES];
+    unsigned long long t, total = 0;
+    unsigned long check = 0;
+    long iterations = 1000000;
+    const char *image = NULL;
+    bool write_image = false;
+    int i;
+
+    if (argc > 1) {
+        iterations = atol(argv[1]);
+    }
+    if (argc > 2) {
+        image = argv[2];
+    }
+
+    t = now_ns();
+    if (image && !type_image_load(image, NULL)) {
+        write_image = true;
+    }
+    object_type_register();
+    bench_register();
+    type_registry_freeze();
+    for (i = 0; i < BENCH_NUM_TYPES; i++) {
+        objs[i] = object_new(type_names[i]);
+    }
+    t = now_ns() - t;
+    total += t;
+    printf("register:  %llu ns\n", t);
+
+    if (write_image) {
+        type_image_write(image, &error_fatal);
+    }
+
+    t = now_ns();
+    check += bench_lifecycle(iterations);
+    t = now_ns() - t;
+    total += t;
+    printf("lifecycle: %llu ns\n", t);
+
+    t = now_ns();
+    check += bench_casts(objs, iterations);
+    t = now_ns() - t;
+    total += t;
+    printf("casts:     %llu ns\n", t);
+
+    t = now_ns();
+    check += bench_dispatch(objs, iterations);
+    t = now_ns() - t;
+    total += t;
+    printf("dispatch:  %llu ns\n", t);
+
+    t = now_ns();
+    check += bench_properties(objs, iterations);
+    t = now_ns() - t;
+    total += t;
+    printf("props:     %llu ns\n", t);
+
+    t = now_ns();
+    check += bench_lookup(iterations);
+    t = now_ns() - t;
+    total += t;
+    printf("lookup:    %llu ns\n", t);
+
+    for (i = 0; i < BENCH_NUM_TYPES; i++) {
+        object_unref(objs[i]);
+    }
+
+    printf("check:     %lu\n", check);
+    printf("total:     %llu ns\n", total);
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * Simple interface for atomic operations.
+ *
+ * Copyright (C) 2013 Red Hat, Inc.
+ *
+ * Author: Paolo Bonzini <pbonzini@redhat.com>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ *
+ * File location: include/qemu/atomic.h
+ */
+
+#ifndef QEMU_ATOMIC_H
+#define QEMU_ATOMIC_H
+
+#include <stdbool.h>
+
+/* Compiler barrier */
+#define barrier()   ({ asm volatile("" ::: "memory"); (void)0; })
+
+#define smp_mb()    __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define smp_mb_release()   __atomic_thread_fence(__ATOMIC_RELEASE)
+#define smp_mb_acquire()   __atomic_thread_fence(__ATOMIC_ACQUIRE)
+
+/* Weak atomic operations prevent the compiler moving other
+ * loads/stores past the atomic operation load/store.  They do not
+ * order against other CPUs.
+ */
+#define qatomic_read(ptr)       __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define qatomic_set(ptr, i)     __atomic_store_n(ptr, i, __ATOMIC_RELAXED)
+
+#define qatomic_load_acquire(ptr)       __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define qatomic_store_release(ptr, i)   __atomic_store_n(ptr, i, __ATOMIC_RELEASE)
+
+/* All the remaining operations are fully sequentially consistent */
+
+#define qatomic_xchg(ptr, i)    __atomic_exchange_n(ptr, i, __ATOMIC_SEQ_CST)
+
+#define qatomic_cmpxchg(ptr, old, new)                                  \
+    ({                                                                  \
+        __typeof__(*(ptr)) _old = (old);                                \
+        (void)__atomic_compare_exchange_n(ptr, &_old, new, false,       \
+                                          __ATOMIC_SEQ_CST,             \
+                                          __ATOMIC_SEQ_CST);            \
+        _old;                                                           \
+    })
+
+/* Provide shorter names for GCC atomic builtins, return old value */
+#define qatomic_fetch_inc(ptr)  __atomic_fetch_add(ptr, 1, __ATOMIC_SEQ_CST)
+#define qatomic_fetch_dec(ptr)  __atomic_fetch_sub(ptr, 1, __ATOMIC_SEQ_CST)
+#define qatomic_fetch_add(ptr, n) __atomic_fetch_add(ptr, n, __ATOMIC_SEQ_CST)
+#define qatomic_fetch_sub(ptr, n) __atomic_fetch_sub(ptr, n, __ATOMIC_SEQ_CST)
+
+/* And even shorter names that return void.  */
+#define qatomic_inc(ptr)        ((void) __atomic_fetch_add(ptr, 1, __ATOMIC_SEQ_CST))
+#define qatomic_dec(ptr)        ((void) __atomic_fetch_sub(ptr, 1, __ATOMIC_SEQ_CST))
+#define qatomic_add(ptr, n)     ((void) __atomic_fetch_add(ptr, n, __ATOMIC_SEQ_CST))
+#define qatomic_sub(ptr, n)     ((void) __atomic_fetch_sub(ptr, n, __ATOMIC_SEQ_CST))
+
+#endif /* QEMU_ATOMIC_H */
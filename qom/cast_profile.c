@@ -0,0 +1,159 @@
+/*
+ * QEMU Object Model cast profiler
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include "cast_profile.h"
+
+#if defined(CONFIG_QOM_CAST_PROFILE)
+
+static pthread_mutex_t cast_profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static GHashTable *cast_profile_sites;
+
+/*
+ * The source typename comes from the TypeImpl and is interned, but
+ * __FILE__ and the target typename are string literals: a cast macro
+ * expanded in several translation units passes a different pointer for
+ * the same string in each, so those are compared by value.  __func__
+ * follows from file and line and is not part of the key.
+ */
+static guint cast_profile_site_hash(gconstpointer v)
+{
+    const CastProfileSite *site = v;
+
+    return g_str_hash(site->file) ^ (guint)site->line * 31 ^
+           g_direct_hash(site->source) * 17 ^ g_str_hash(site->target);
+}
+
+static gboolean cast_profile_site_equal(gconstpointer v1, gconstpointer v2)
+{
+    const CastProfileSite *a = v1, *b = v2;
+
+    return a->line == b->line && a->source == b->source &&
+           !strcmp(a->file, b->file) && !strcmp(a->target, b->target);
+}
+
+guint64 cast_profile_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void cast_profile_record(const char *file, int line, const char *func,
+                         const char *source, const char *target,
+                         bool success, guint64 ns)
+{
+    CastProfileSite key = {
+        .file = file, .line = line, .func = func,
+        .source = source, .target = target,
+    };
+    CastProfileSite *site;
+
+    pthread_mutex_lock(&cast_profile_lock);
+    if (!cast_profile_sites) {
+        cast_profile_sites = g_hash_table_new_full(cast_profile_site_hash,
+                                                   cast_profile_site_equal,
+                                                   NULL, g_free);
+    }
+
+    site = g_hash_table_lookup(cast_profile_sites, &key);
+    if (!site) {
+        site = g_memdup(&key, sizeof(key));
+        g_hash_table_insert(cast_profile_sites, site, site);
+    }
+
+    site->count++;
+    site->failures += !success;
+    site->total_ns += ns;
+    pthread_mutex_unlock(&cast_profile_lock);
+}
+
+static void cast_profile_collect(gpointer key, gpointer value,
+                                 gpointer opaque)
+{
+    GSList **list = opaque;
+
+    *list = g_slist_prepend(*list, g_memdup(value, sizeof(CastProfileSite)));
+}
+
+static gint cast_profile_compare_count(gconstpointer a, gconstpointer b)
+{
+    const CastProfileSite *sa = a, *sb = b;
+
+    if (sa->count != sb->count) {
+        return sa->count < sb->count ? 1 : -1;
+    }
+    return sa->line - sb->line;
+}
+
+void qom_cast_profile_dump(FILE *out, int max_sites)
+{
+    GSList *list = NULL, *e;
+    int n = 0;
+
+    pthread_mutex_lock(&cast_profile_lock);
+    if (cast_profile_sites) {
+        g_hash_table_foreach(cast_profile_sites, cast_profile_collect, &list);
+    }
+    pthread_mutex_unlock(&cast_profile_lock);
+
+    list = g_slist_sort(list, cast_profile_compare_count);
+
+    fprintf(out, "%-40s %-40s %12s %10s %10s\n",
+            "site", "source -> target", "count", "failures", "avg ns");
+    for (e = list; e && (max_sites <= 0 || n < max_sites); e = e->next, n++) {
+        CastProfileSite *site = e->data;
+        char where[256], pair[256];
+
+        g_snprintf(where, sizeof(where), "%s:%d:%s",
+                   site->file, site->line, site->func);
+        g_snprintf(pair, sizeof(pair), "%s -> %s",
+                   site->source ? site->source : "(null)", site->target);
+        fprintf(out, "%-40s %-40s %12llu %10llu %10llu\n", where, pair,
+                site->count, site->failures, site->total_ns / site->count);
+    }
+
+    g_slist_foreach(list, (GFunc)g_free, NULL);
+    g_slist_free(list);
+}
+
+void qom_cast_profile_reset(void)
+{
+    pthread_mutex_lock(&cast_profile_lock);
+    if (cast_profile_sites) {
+        g_hash_table_remove_all(cast_profile_sites);
+    }
+    pthread_mutex_unlock(&cast_profile_lock);
+}
+
+#else
+
+guint64 cast_profile_clock(void)
+{
+    return 0;
+}
+
+void cast_profile_record(const char *file, int line, const char *func,
+                         const char *source, const char *target,
+                         bool success, guint64 ns)
+{
+}
+
+void qom_cast_profile_dump(FILE *out, int max_sites)
+{
+    fprintf(out, "cast profiling is not enabled, "
+                 "build with CONFIG_QOM_CAST_PROFILE\n");
+}
+
+void qom_cast_profile_reset(void)
+{
+}
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * QEMU Object Model cast profiler
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+/*
+ * When built with CONFIG_QOM_CAST_PROFILE, every OBJECT_CHECK(),
+ * OBJECT_CLASS_CHECK() and INTERFACE_CHECK() is recorded per call site
+ * and source -> target type pair: how often it ran, how often the cast
+ * failed and how long the dynamic cast took.  The hottest sites are the
+ * best candidates for a static cast or a cached class pointer.
+ */
+
+#ifndef QOM_CAST_PROFILE_H
+#define QOM_CAST_PROFILE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "glib.h"
+
+G_BEGIN_DECLS
+
+/**
+ * CastProfileSite:
+ * @file: Source file of the cast macro.
+ * @line: Source line of the cast macro.
+ * @func: Function containing the cast macro.
+ * @source: QOM typename of the object or class being cast.
+ * @target: QOM typename cast to.
+ * @count: Number of casts.
+ * @failures: Number of casts that did not match @target.
+ * @total_ns: Cumulative time spent in the dynamic cast.
+ */
+typedef struct CastProfileSite {
+    const char *file;
+    int line;
+    const char *func;
+    const char *source;
+    const char *target;
+    guint64 count;
+    guint64 failures;
+    guint64 total_ns;
+} CastProfileSite;
+
+guint64 cast_profile_clock(void);
+
+void cast_profile_record(const char *file, int line, const char *func,
+                         const char *source, const char *target,
+                         bool success, guint64 ns);
+
+/**
+ * qom_cast_profile_dump:
+ * @out: Stream to print to.
+ * @max_sites: Maximum number of sites to print, 0 for all of them.
+ *
+ * Print the recorded cast sites, most frequently executed first.
+ */
+void qom_cast_profile_dump(FILE *out, int max_sites);
+
+/**
+ * qom_cast_profile_reset:
+ *
+ * Forget all recorded cast sites.
+ */
+void qom_cast_profile_reset(void);
+
+G_END_DECLS
+
+#endif
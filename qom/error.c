@@ -11,9 +11,12 @@
  */
 
 
+#include <errno.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "glib.h"
 #include "error.h"
 
@@ -21,15 +24,13 @@
  * Special error destination to abort on error.
  * See error_setg() and error_propagate() for details.
  */
-extern Error *error_abort;
+Error *error_abort;
 
 /*
  * Special error destination to exit(1) on error.
  * See error_setg() and error_propagate() for details.
  */
-extern Error *error_fatal;
-
-extern int errno;
+Error *error_fatal;
 
 static void error_handle_fatal(Error **errp, Error *err)
 {
@@ -45,6 +46,166 @@ static void error_handle_fatal(Error **errp, Error *err)
     }
 }
 
+/*
+ * Errors are usually created only to be checked and thrown away, so
+ * freed Error structs are kept on a small per-thread free list and
+ * reused by the next error_setv() on that thread.  The list is freed
+ * when the thread exits.
+ */
+#define ERROR_FREE_LIST_MAX 16
+
+static __thread Error *error_free_list;
+static __thread int error_free_list_len;
+
+static pthread_key_t error_free_list_key;
+static pthread_once_t error_free_list_once = PTHREAD_ONCE_INIT;
+
+static void error_free_list_destroy(void *opaque)
+{
+    Error *err, *next;
+
+    for (err = error_free_list; err; err = next) {
+        next = err->next_free;
+        g_free(err);
+    }
+    error_free_list = NULL;
+    error_free_list_len = 0;
+}
+
+static void error_free_list_init(void)
+{
+    pthread_key_create(&error_free_list_key, error_free_list_destroy);
+}
+
+static Error *error_alloc(void)
+{
+    Error *err = error_free_list;
+
+    if (err) {
+        error_free_list = err->next_free;
+        error_free_list_len--;
+        err->next_free = NULL;
+    } else {
+        err = g_malloc0(sizeof(*err));
+    }
+
+    err->frames = err->frame_inline;
+    err->max_frames = ERROR_INLINE_FRAMES;
+
+    return err;
+}
+
+static void error_release(Error *err)
+{
+    if (error_free_list_len < ERROR_FREE_LIST_MAX) {
+        if (!error_free_list) {
+            /* A thread-specific value is needed for the destructor to
+             * run at thread exit; any non-NULL value will do.
+             */
+            pthread_once(&error_free_list_once, error_free_list_init);
+            pthread_setspecific(error_free_list_key, &error_free_list);
+        }
+        err->next_free = error_free_list;
+        error_free_list = err;
+        error_free_list_len++;
+        return;
+    }
+
+    g_free(err);
+}
+
+/*
+ * Format @fmt into the @size bytes at @buf starting at *@used, and
+ * advance *@used past the result.  Text that does not fit is heap
+ * allocated and *@allocated is set.
+ */
+static char *error_vformat(char *buf, int size, int *used,
+                           bool *allocated, const char *fmt, va_list ap)
+{
+    char *text = buf + *used;
+    int avail = size - *used;
+    va_list ap2;
+    int len;
+
+    *allocated = false;
+
+    G_VA_COPY(ap2, ap);
+    len = g_vsnprintf(text, avail, fmt, ap2);
+    va_end(ap2);
+
+    if (len >= 0 && len < avail) {
+        *used += len + 1;
+        return text;
+    }
+
+    *allocated = true;
+    return g_strdup_vprintf(fmt, ap);
+}
+
+static void error_format_msg(Error *err, const char *fmt, va_list ap)
+{
+    int used = 0;
+
+    err->msg = error_vformat(err->msg_buf, sizeof(err->msg_buf), &used,
+                             &err->msg_allocated, fmt, ap);
+}
+
+static void error_add_frame(Error *err, ErrorFrameKind kind,
+                            const char *src, int line, const char *func,
+                            const char *fmt, va_list ap)
+{
+    ErrorFrame *frame;
+
+    if (err->num_frames == err->max_frames) {
+        ErrorFrame *frames = g_new(ErrorFrame, err->max_frames * 2);
+
+        memcpy(frames, err->frames, err->num_frames * sizeof(*frames));
+        if (err->frames != err->frame_inline) {
+            g_free(err->frames);
+        }
+        err->frames = frames;
+        err->max_frames *= 2;
+    }
+
+    frame = &err->frames[err->num_frames++];
+    frame->kind = kind;
+    frame->src = src;
+    frame->line = line;
+    frame->func = func;
+    frame->text = error_vformat(err->frame_buf, sizeof(err->frame_buf),
+                                &err->frame_buf_used, &frame->text_allocated,
+                                fmt, ap);
+
+    /* Any cached rendering is stale now. */
+    g_free(err->pretty);
+    err->pretty = NULL;
+}
+
+static void error_print(const Error *err, FILE *out)
+{
+    int i;
+
+    for (; err; err = err->cause) {
+        /* The last prepended text ends up in front. */
+        for (i = err->num_frames - 1; i >= 0; i--) {
+            if (err->frames[i].kind == ERROR_FRAME_PREPEND) {
+                fputs(err->frames[i].text, out);
+            }
+        }
+        fprintf(out, "%s\n", err->msg);
+
+        for (i = 0; i < err->num_frames; i++) {
+            if (err->frames[i].kind == ERROR_FRAME_HINT) {
+                fputs(err->frames[i].text, out);
+            }
+        }
+
+        if (err->cause) {
+            fputs("Caused by: ", out);
+        }
+    }
+}
+
 static void error_setv(Error **errp,
                        const char *src, int line, const char *func,
                        ErrorClass err_class, const char *fmt, va_list ap)
@@ -57,8 +218,8 @@ static void error_setv(Error **errp,
     }
     g_assert(*errp == NULL);
 
-    err = g_malloc0(sizeof(*err));
-    err->msg = g_strdup_vprintf(fmt, ap);
+    err = error_alloc();
+    error_format_msg(err, fmt, ap);
 
     err->err_class = err_class;
     err->src = src;
@@ -111,18 +272,153 @@ void error_setg_errno_internal(Error **errp,
     errno = saved_errno;
 }
 
+void error_prepend_internal(Error **errp,
+                            const char *src, int line, const char *func,
+                            const char *fmt, ...)
+{
+    va_list ap;
+
+    if (!errp || !*errp) {
+        return;
+    }
+
+    va_start(ap, fmt);
+    error_add_frame(*errp, ERROR_FRAME_PREPEND, src, line, func, fmt, ap);
+    va_end(ap);
+}
+
+void error_append_hint_internal(Error **errp,
+                                const char *src, int line, const char *func,
+                                const char *fmt, ...)
+{
+    va_list ap;
+    int saved_errno = errno;
+
+    g_assert(errp != &error_fatal && errp != &error_abort);
+    if (!errp || !*errp) {
+        return;
+    }
+
+    va_start(ap, fmt);
+    error_add_frame(*errp, ERROR_FRAME_HINT, src, line, func, fmt, ap);
+    va_end(ap);
+
+    errno = saved_errno;
+}
+
+void error_set_cause(Error **errp, Error *cause)
+{
+    Error *err;
+
+    if (!cause) {
+        return;
+    }
+    if (!errp || !*errp) {
+        error_free(cause);
+        return;
+    }
+
+    for (err = *errp; err->cause; err = err->cause) {
+        /* nothing */
+    }
+    err->cause = cause;
+}
+
+Error *error_get_cause(const Error *err)
+{
+    return err->cause;
+}
+
+const char *error_get_pretty(const Error *err)
+{
+    Error *mut = (Error *)err;
+    size_t len;
+    char *p;
+    int i;
+
+    if (err->pretty) {
+        return err->pretty;
+    }
+
+    len = strlen(err->msg) + 1;
+    for (i = 0; i < err->num_frames; i++) {
+        if (err->frames[i].kind == ERROR_FRAME_PREPEND) {
+            len += strlen(err->frames[i].text);
+        }
+    }
+    if (len == strlen(err->msg) + 1) {
+        return err->msg;
+    }
+
+    /* Rendered on first use only and cached until the next frame. */
+    p = mut->pretty = g_new(char, len);
+    for (i = err->num_frames - 1; i >= 0; i--) {
+        if (err->frames[i].kind == ERROR_FRAME_PREPEND) {
+            size_t n = strlen(err->frames[i].text);
+
+            memcpy(p, err->frames[i].text, n);
+            p += n;
+        }
+    }
+    strcpy(p, err->msg);
+
+    return err->pretty;
+}
+
+ErrorClass error_get_class(const Error *err)
+{
+    return err->err_class;
+}
+
 void error_report_err(Error *err)
 {
-    fprintf(stderr, "%s\n", err->msg);
+    error_print(err, stderr);
 
     error_free(err);
 }
 
+void error_reportf_err_internal(Error *err,
+                                const char *src, int line, const char *func,
+                                const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    error_add_frame(err, ERROR_FRAME_PREPEND, src, line, func, fmt, ap);
+    va_end(ap);
+
+    error_report_err(err);
+}
+
 void error_free(Error *err)
 {
+    int i;
+
     if (err) {
-        g_free(err->msg);
-        g_free(err);
+        error_free(err->cause);
+        err->cause = NULL;
+
+        for (i = 0; i < err->num_frames; i++) {
+            if (err->frames[i].text_allocated) {
+                g_free((char *)err->frames[i].text);
+            }
+        }
+        if (err->frames != err->frame_inline) {
+            g_free(err->frames);
+        }
+        err->frames = NULL;
+        err->num_frames = 0;
+        err->frame_buf_used = 0;
+
+        g_free(err->pretty);
+        err->pretty = NULL;
+
+        if (err->msg_allocated) {
+            g_free(err->msg);
+        }
+        err->msg = NULL;
+        err->msg_allocated = false;
+        error_release(err);
     }
 }
 
@@ -139,3 +435,18 @@ void error_propagate(Error **dst_errp, Error *local_err)
     }
 }
 
+void error_propagate_prepend_internal(Error **dst_errp, Error *err,
+                                      const char *src, int line,
+                                      const char *func,
+                                      const char *fmt, ...)
+{
+    va_list ap;
+
+    if (dst_errp && !*dst_errp && err) {
+        va_start(ap, fmt);
+        error_add_frame(err, ERROR_FRAME_PREPEND, src, line, func, fmt, ap);
+        va_end(ap);
+    }
+
+    error_propagate(dst_errp, err);
+}
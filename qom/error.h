@@ -112,6 +112,10 @@
 #ifndef ERROR_H
 #define ERROR_H
 
+#include <stdbool.h>
+#include <stdarg.h>
+#include "glib.h"
+
 G_BEGIN_DECLS 
 /*
  * Overall category of an error.
@@ -126,6 +130,34 @@ typedef enum ErrorClass {
     ERROR_CLASS_KVM_MISSING_CAP,
 } ErrorClass;
 
+/*
+ * Messages up to this size are formatted into the Error itself, so
+ * creating an error does not need a separate allocation for its text.
+ */
+#define ERROR_INLINE_MSG_SIZE 128
+
+/*
+ * Context added by error_prepend() and error_append_hint() is kept as
+ * frames inside the Error and only rendered when the error is reported.
+ * The first ERROR_INLINE_FRAMES frames, and their text up to
+ * ERROR_FRAME_BUF_SIZE bytes in total, need no allocation.
+ */
+#define ERROR_INLINE_FRAMES 4
+#define ERROR_FRAME_BUF_SIZE 128
+
+typedef enum ErrorFrameKind {
+    ERROR_FRAME_PREPEND,
+    ERROR_FRAME_HINT,
+} ErrorFrameKind;
+
+typedef struct ErrorFrame {
+    const char *text;
+    const char *src, *func;
+    int line;
+    ErrorFrameKind kind;
+    bool text_allocated;
+} ErrorFrame;
+
 typedef struct _Error Error;
 struct _Error
 {
@@ -133,8 +165,25 @@ struct _Error
     ErrorClass err_class;
     const char *src, *func;
     int line;
+    /*< private >*/
+    bool msg_allocated;
+    Error *cause;
+    Error *next_free;
+    char *pretty;
+    ErrorFrame *frames;
+    int num_frames;
+    int max_frames;
+    int frame_buf_used;
+    char msg_buf[ERROR_INLINE_MSG_SIZE];
+    ErrorFrame frame_inline[ERROR_INLINE_FRAMES];
+    char frame_buf[ERROR_FRAME_BUF_SIZE];
 };
 
+/*
+ * Special error destinations, see error_setg() and error_propagate().
+ */
+extern Error *error_abort;
+extern Error *error_fatal;
 
 /*
  * Create a new error object and assign it to *@errp.
@@ -176,9 +225,96 @@ void error_setg_internal(Error **errp,
  */
 void error_propagate(Error **dst_errp, Error *local_err);
 
+/*
+ * Convenience function to error_prepend(), then error_propagate()
+ * @local_err to @dst_errp.  The text is only prepended when
+ * @local_err is actually propagated.
+ */
+#define error_propagate_prepend(dst_errp, local_err, fmt, ...)      \
+    error_propagate_prepend_internal((dst_errp), (local_err),       \
+                                     __FILE__, __LINE__, __func__,  \
+                                     (fmt), ## __VA_ARGS__)
+void error_propagate_prepend_internal(Error **dst_errp, Error *local_err,
+                                      const char *src, int line,
+                                      const char *func,
+                                      const char *fmt, ...)
+    G_GNUC_PRINTF(6, 7);
+
+/*
+ * Prepend some text to @errp's human-readable error message.
+ * The text is made by formatting @fmt, ...  It is recorded together
+ * with the caller's location and only rendered when the error is
+ * reported, or when error_get_pretty() is called.
+ * If @errp is NULL or *@errp is NULL, do nothing.
+ */
+#define error_prepend(errp, fmt, ...)                               \
+    error_prepend_internal((errp), __FILE__, __LINE__, __func__,    \
+                           (fmt), ## __VA_ARGS__)
+void error_prepend_internal(Error **errp,
+                            const char *src, int line, const char *func,
+                            const char *fmt, ...) G_GNUC_PRINTF(5, 6);
+
+/*
+ * Append a printf-style human-readable explanation to an existing error.
+ * If the error is later reported to a human user with
+ * error_report_err(), the hint will be shown, too.  If it's reported
+ * via error_get_pretty(), it will be lost.
+ * Trivially the case if the error is ignored.
+ * @errp may be NULL, but not &error_fatal or &error_abort.
+ * Use it only when you need to explain how to recover.
+ * May be called multiple times.  The resulting hint should end with a
+ * newline.
+ */
+#define error_append_hint(errp, fmt, ...)                               \
+    error_append_hint_internal((errp), __FILE__, __LINE__, __func__,    \
+                               (fmt), ## __VA_ARGS__)
+void error_append_hint_internal(Error **errp,
+                                const char *src, int line, const char *func,
+                                const char *fmt, ...) G_GNUC_PRINTF(5, 6);
 
+/*
+ * Record @cause as the error that led to *@errp.  Ownership of @cause
+ * passes to *@errp; it is reported after it and freed with it.  If
+ * *@errp already has a cause, @cause is attached at the end of the
+ * chain.
+ * If @errp is NULL or *@errp is NULL, @cause is freed.
+ */
+void error_set_cause(Error **errp, Error *cause);
+
+/*
+ * Get the error that caused @err, or %NULL.
+ */
+Error *error_get_cause(const Error *err);
+
+
+/*
+ * Get @err's human-readable error message.
+ */
+const char *error_get_pretty(const Error *err);
+
+/*
+ * Get @err's error class.
+ * Note: use of error classes other than ERROR_CLASS_GENERIC_ERROR is
+ * strongly discouraged.
+ */
+ErrorClass error_get_class(const Error *err);
+
+/*
+ * Report @err to stderr, including its prepended context, hints and
+ * causes, and free it.
+ */
 void error_report_err(Error *err);
 
+/*
+ * Convenience function to error_prepend() and error_report_err().
+ */
+#define error_reportf_err(err, fmt, ...)                                \
+    error_reportf_err_internal((err), __FILE__, __LINE__, __func__,     \
+                               (fmt), ## __VA_ARGS__)
+void error_reportf_err_internal(Error *err,
+                                const char *src, int line, const char *func,
+                                const char *fmt, ...) G_GNUC_PRINTF(5, 6);
+
 /*
  * Free @err.
  * @err may be NULL.
@@ -787,7 +787,7 @@ g_hash_table_iter_next (GHashTableIter *iter,
   if (iter == NULL) return FALSE;
 
   // g_return_val_if_fail (ri->position < ri->hash_table->size, FALSE);
-  if (ri->position < ri->hash_table->size) return FALSE;
+  if (ri->position >= ri->hash_table->size) return FALSE;
 
   position = ri->position;
 
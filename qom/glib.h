@@ -33,6 +33,7 @@
 #include "gtestutil.h"
 #include "gstrfuncs.h"
 #include "gslist.h"
+#include "gquark.h"
 
 #endif /* __G_LIB_H__ */
 
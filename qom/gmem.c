@@ -29,10 +29,12 @@
 
 #include <malloc.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "gmem.h"
 
 
 /* --- functions --- */
+/* Like GLib, abort when memory runs out instead of returning NULL. */
 gpointer
 g_malloc (gulong n_bytes)
 {
@@ -43,7 +45,8 @@ g_malloc (gulong n_bytes)
       mem = malloc (n_bytes);
       if (mem) return mem;
 
-      fprintf (stderr, "failed to allocate %lu bytes",n_bytes);
+      fprintf (stderr, "failed to allocate %lu bytes\n", n_bytes);
+      abort ();
     }
 
   return NULL;
@@ -59,7 +62,8 @@ g_malloc0 (gulong n_bytes)
       mem = calloc (1, n_bytes);
       if (mem) return mem;
 
-      fprintf (stderr, "failed to allocate %lu bytes",n_bytes);
+      fprintf (stderr, "failed to allocate %lu bytes\n", n_bytes);
+      abort ();
     }
 
   return NULL;
@@ -74,7 +78,8 @@ g_realloc (gpointer mem,
       mem = realloc (mem, n_bytes);
       if (mem) return mem;
 
-      fprintf (stderr, "failed to allocate %lu bytes",n_bytes);
+      fprintf (stderr, "failed to allocate %lu bytes\n", n_bytes);
+      abort ();
     }
 
   if (mem) free (mem);
@@ -0,0 +1,143 @@
+/* GLIB - Library of useful routines for C programming
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Modified by the GLib Team and others 1997-2000.  See the AUTHORS
+ * file for a list of people on the GLib Team.  See the ChangeLog
+ * files for a list of changes.  These files are distributed with
+ * GLib at ftp://ftp.gtk.org/pub/gtk/.
+ */
+
+/*
+ * MT safe
+ */
+
+#include <string.h>
+#include <pthread.h>
+#include "ghash.h"
+#include "gmem.h"
+#include "gquark.h"
+
+#define QUARK_STRING_BLOCK_SIZE (4096 - sizeof (gsize))
+
+static pthread_mutex_t quark_global_lock = PTHREAD_MUTEX_INITIALIZER;
+static GHashTable *quark_ht = NULL;
+static gchar *quark_block = NULL;
+static gulong quark_block_offset = 0;
+
+/* Interned strings are never freed, so they are packed into large
+ * blocks instead of getting one malloc() chunk each.  Strings longer
+ * than half a block get an allocation of their own.
+ */
+static gchar *
+quark_strdup (const gchar *string)
+{
+  gchar *copy;
+  gulong len;
+
+  len = strlen (string) + 1;
+
+  if (len > QUARK_STRING_BLOCK_SIZE / 2)
+    {
+      copy = g_new (gchar, len);
+      memcpy (copy, string, len);
+      return copy;
+    }
+
+  if (quark_block == NULL ||
+      QUARK_STRING_BLOCK_SIZE - quark_block_offset < len)
+    {
+      quark_block = g_new (gchar, QUARK_STRING_BLOCK_SIZE);
+      quark_block_offset = 0;
+    }
+
+  copy = quark_block + quark_block_offset;
+  memcpy (copy, string, len);
+  quark_block_offset += len;
+
+  return copy;
+}
+
+/* HOLDS: quark_global_lock */
+static const gchar *
+quark_intern (const gchar *string,
+              gboolean     duplicate)
+{
+  gchar *result;
+
+  if (quark_ht == NULL)
+    quark_ht = g_hash_table_new (g_str_hash, g_str_equal);
+
+  result = g_hash_table_lookup (quark_ht, string);
+  if (result == NULL)
+    {
+      result = duplicate ? quark_strdup (string) : (gchar *) string;
+      g_hash_table_insert (quark_ht, result, result);
+    }
+
+  return result;
+}
+
+/**
+ * g_intern_string:
+ * @string: (nullable): a string
+ *
+ * Returns a canonical representation for @string. Interned strings
+ * can be compared for equality by comparing the pointers, instead of
+ * using strcmp().
+ *
+ * Returns: a canonical representation for the string
+ */
+const gchar *
+g_intern_string (const gchar *string)
+{
+  const gchar *result;
+
+  if (!string)
+    return NULL;
+
+  pthread_mutex_lock (&quark_global_lock);
+  result = quark_intern (string, TRUE);
+  pthread_mutex_unlock (&quark_global_lock);
+
+  return result;
+}
+
+/**
+ * g_intern_static_string:
+ * @string: (nullable): a static string
+ *
+ * Returns a canonical representation for @string. Interned strings
+ * can be compared for equality by comparing the pointers, instead of
+ * using strcmp(). g_intern_static_string() does not copy the string,
+ * therefore @string must not be freed or modified.
+ *
+ * Returns: a canonical representation for the string
+ */
+const gchar *
+g_intern_static_string (const gchar *string)
+{
+  const gchar *result;
+
+  if (!string)
+    return NULL;
+
+  pthread_mutex_lock (&quark_global_lock);
+  result = quark_intern (string, FALSE);
+  pthread_mutex_unlock (&quark_global_lock);
+
+  return result;
+}
@@ -56,22 +56,104 @@ g_memdup (gconstpointer mem, guint byte_size)
   return new_mem;
 }
 
+/**
+ * g_vsnprintf:
+ * @string: the buffer to hold the output.
+ * @n: the maximum number of bytes to produce (including the
+ *     terminating nul character).
+ * @format: a standard printf() format string.
+ * @args: the list of arguments to insert in the output.
+ *
+ * A safer form of the standard vsprintf() function. The output is
+ * guaranteed to not exceed @n characters (including the terminating
+ * nul character), so it is easy to ensure that a buffer overflow
+ * cannot occur.
+ *
+ * Returns: the number of bytes which would be produced if the buffer
+ *     was large enough.
+ */
+gint
+g_vsnprintf (gchar       *string,
+             gulong       n,
+             const gchar *format,
+             va_list      args)
+{
+  return vsnprintf (string, n, format, args);
+}
+
+/**
+ * g_snprintf:
+ * @string: the buffer to hold the output.
+ * @n: the maximum number of bytes to produce (including the
+ *     terminating nul character).
+ * @format: a standard printf() format string.
+ * @...: the arguments to insert in the output.
+ *
+ * Formats into a caller supplied buffer, see g_vsnprintf().
+ *
+ * Returns: the number of bytes which would be produced if the buffer
+ *     was large enough.
+ */
+gint
+g_snprintf (gchar       *string,
+            gulong       n,
+            const gchar *format,
+            ...)
+{
+  va_list args;
+  gint retval;
+
+  va_start (args, format);
+  retval = g_vsnprintf (string, n, format, args);
+  va_end (args);
+
+  return retval;
+}
+
+/* Most strings built by QOM (interface type names, error messages) are
+ * short, so they are formatted into a stack buffer first and only the
+ * exact number of bytes is copied to the heap.  Longer strings take a
+ * second formatting pass into an exactly sized allocation.
+ */
+#define G_PRINTF_STACK_BUFSIZ 256
+
+/**
+ * g_strdup_vprintf:
+ * @format: a standard printf() format string.
+ * @args: the list of parameters to insert into the format string
+ *
+ * Similar to the standard C vsprintf() function but safer, since it
+ * calculates the maximum space required and allocates memory to hold
+ * the result. The returned string should be freed with g_free() when
+ * no longer needed.
+ *
+ * Returns: a newly-allocated string holding the result
+ */
 gchar*
 g_strdup_vprintf (const gchar *format, va_list args1)
 {
+  gchar stack_buf[G_PRINTF_STACK_BUFSIZ];
   gchar *buffer;
   va_list args2;
+  gint len;
 
   G_VA_COPY (args2, args1);
+  len = g_vsnprintf (stack_buf, sizeof (stack_buf), format, args1);
 
+  if (len < 0)
+    {
+      va_end (args2);
+      return NULL;
+    }
+
+  if ((gulong) len < sizeof (stack_buf))
+    {
+      va_end (args2);
+      return g_memdup (stack_buf, len + 1);
+    }
 
-  #define MAX_BUFSIZ 256
-  // buffer = g_new(gchar, g_printf_string_upper_bound (format, args1));
-  // TODO Not use g_printf_string_upper_bound in gmessage.c, instead of
-  // a constant to define the buffer size.
-  buffer = g_new(gchar, MAX_BUFSIZ);
-  buffer[MAX_BUFSIZ-1] = '\0';
-  vsprintf (buffer, format, args2);
+  buffer = g_new (gchar, (gulong) len + 1);
+  g_vsnprintf (buffer, (gulong) len + 1, format, args2);
   va_end (args2);
 
   return buffer;
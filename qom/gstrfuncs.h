@@ -33,13 +33,21 @@ gchar* g_strdup	(const gchar *str);
 
 gpointer g_memdup (gconstpointer mem, guint byte_size);
 
-gchar* g_strdup_vprintf (const gchar *format, va_list args1);
-gchar* g_strdup_printf (const gchar *format, ...);
+gint g_vsnprintf (gchar *string, gulong n, const gchar *format, va_list args)
+     G_GNUC_PRINTF (3, 0);
+gint g_snprintf (gchar *string, gulong n, const gchar *format, ...)
+     G_GNUC_PRINTF (3, 4);
+
+gchar* g_strdup_vprintf (const gchar *format, va_list args1)
+       G_GNUC_PRINTF (1, 0);
+gchar* g_strdup_printf (const gchar *format, ...) G_GNUC_PRINTF (1, 2);
 
 G_END_DECLS
 
 #if !defined (G_VA_COPY)
-#  if defined (__GNUC__) && defined (__PPC__) && (defined (_CALL_SYSV) || defined (_WIN32))
+#  if defined (va_copy)
+#    define G_VA_COPY(ap1, ap2)	  va_copy ((ap1), (ap2))
+#  elif defined (__GNUC__) && defined (__PPC__) && (defined (_CALL_SYSV) || defined (_WIN32))
 #    define G_VA_COPY(ap1, ap2)	  (*(ap1) = *(ap2))
 #  elif defined (G_VA_COPY_AS_ARRAY)
 #    define G_VA_COPY(ap1, ap2)	  memmove ((ap1), (ap2), sizeof (va_list))
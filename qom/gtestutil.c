@@ -40,9 +40,24 @@ g_assertion_message (const char     *file,
   if (!message)
     message = "code should not be reached";
 
-  char str[256];
-  sprintf(str, "ERROR: in %s %d %s\n%s", file, line, func, message);
-  fprintf(stderr, "%s\n", str);
+  fprintf(stderr, "ERROR: in %s %d %s\n%s\n", file, line, func, message);
+
+  exit(1);
+}
+
+/**
+ * g_assertion_failed: (skip)
+ * @file:
+ * @line:
+ *
+ * Failure path of the G_ASSERT_LEVEL_CHEAP assertions, which only
+ * carry their location.
+ */
+void
+g_assertion_failed (const char     *file,
+                    int             line)
+{
+  fprintf(stderr, "ERROR: in %s %d\nassertion failed\n", file, line);
 
   exit(1);
 }
@@ -64,9 +79,9 @@ g_assertion_message_expr (const char     *file,
   char str[256];
 
   if (!expr)
-    sprintf(str, "code should not be reached");
+    snprintf(str, sizeof(str), "code should not be reached");
   else
-    sprintf(str, "assertion failed: ( %s )", expr);
+    snprintf(str, sizeof(str), "assertion failed: ( %s )", expr);
 
   g_assertion_message (file, line, func, str);
 }
@@ -86,19 +101,19 @@ g_assertion_message_cmpnum (const char     *file,
   switch (numtype)
     {
     case 'i':
-         sprintf(str, 
+         snprintf(str, sizeof(str),
                  "assertion failed (%s): (%" \
                  G_GINT64_MODIFIER "i %s %" G_GINT64_MODIFIER "i)", 
                  expr, (gint64)arg1, cmp, (gint64) arg2); 
         break;
     case 'x':
-        sprintf(str, 
+        snprintf(str, sizeof(str),
                 "assertion failed (%s): (0x%08" \
                 G_GINT64_MODIFIER "x %s 0x%08" G_GINT64_MODIFIER "x)", 
                 expr, (guint64)arg1, cmp, (guint64)arg2); 
         break;
     case 'f':
-        sprintf(str,
+        snprintf(str, sizeof(str),
                 "assertion failed (%s): (%.9g %s %.9g)",
                 expr, (double)arg1, cmp, (double)arg2); 
         break;
@@ -24,26 +24,61 @@ G_BEGIN_DECLS
 #define G_STRFUNC __func__
 #define G_GINT64_MODIFIER "ll"
 
+/* Assertion levels, selected at build time with -DG_ASSERT_LEVEL=n:
+ *
+ * G_ASSERT_LEVEL_OFF:   assertions compile to nothing.
+ * G_ASSERT_LEVEL_CHEAP: conditions are still checked, behind a branch
+ *                       hint; a failure only reports its location.
+ * G_ASSERT_LEVEL_FULL:  a failure also reports the expression and the
+ *                       compared values.  This is the default.
+ *
+ * Defining G_DISABLE_ASSERT selects G_ASSERT_LEVEL_OFF.  At every level
+ * the failure reporting lives in cold, out-of-line functions so the
+ * checking code stays off the hot path.
+ */
+#define G_ASSERT_LEVEL_OFF   0
+#define G_ASSERT_LEVEL_CHEAP 1
+#define G_ASSERT_LEVEL_FULL  2
+
+#ifndef G_ASSERT_LEVEL
+#  ifdef G_DISABLE_ASSERT
+#    define G_ASSERT_LEVEL G_ASSERT_LEVEL_OFF
+#  else
+#    define G_ASSERT_LEVEL G_ASSERT_LEVEL_FULL
+#  endif
+#endif
+
 /* assertion API */
+#if G_ASSERT_LEVEL >= G_ASSERT_LEVEL_FULL
 #define g_assert_cmpint(n1, cmp, n2)    G_STMT_START { \
                                              gint64 __n1 = (n1), __n2 = (n2); \
-                                             if (__n1 cmp __n2) ; else \
+                                             if (G_LIKELY (__n1 cmp __n2)) ; else \
                                                g_assertion_message_cmpnum (__FILE__, __LINE__, G_STRFUNC, \
                                                  #n1 " " #cmp " " #n2, (long double) __n1, #cmp, (long double) __n2, 'i'); \
                                         } G_STMT_END
 
-#ifdef G_DISABLE_ASSERT
-#define g_assert_not_reached()          G_STMT_START { (void) 0; } G_STMT_END
-#define g_assert(expr)                  G_STMT_START { (void) 0; } G_STMT_END
-#else /* !G_DISABLE_ASSERT */
 #define g_assert_not_reached()          G_STMT_START { g_assertion_message_expr (__FILE__, __LINE__, G_STRFUNC, NULL);\
                                         } G_STMT_END
 
 #define g_assert(expr)                  G_STMT_START { \
-                                             if (expr) ; else \
+                                             if (G_LIKELY (expr)) ; else \
                                                g_assertion_message_expr (__FILE__, __LINE__, G_STRFUNC, #expr);\
                                         } G_STMT_END
-#endif /* !G_DISABLE_ASSERT */
+#elif G_ASSERT_LEVEL == G_ASSERT_LEVEL_CHEAP
+#define g_assert_cmpint(n1, cmp, n2)    G_STMT_START { \
+                                             if (G_LIKELY ((gint64) (n1) cmp (gint64) (n2))) ; else \
+                                               g_assertion_failed (__FILE__, __LINE__); \
+                                        } G_STMT_END
+#define g_assert_not_reached()          G_STMT_START { g_assertion_failed (__FILE__, __LINE__); } G_STMT_END
+#define g_assert(expr)                  G_STMT_START { \
+                                             if (G_LIKELY (expr)) ; else \
+                                               g_assertion_failed (__FILE__, __LINE__); \
+                                        } G_STMT_END
+#else /* G_ASSERT_LEVEL_OFF */
+#define g_assert_cmpint(n1, cmp, n2)    G_STMT_START { (void) 0; } G_STMT_END
+#define g_assert_not_reached()          G_STMT_START { (void) 0; } G_STMT_END
+#define g_assert(expr)                  G_STMT_START { (void) 0; } G_STMT_END
+#endif /* G_ASSERT_LEVEL_OFF */
 
 int     g_strcmp0                       (const char     *str1,
                                          const char     *str2);
@@ -51,12 +86,14 @@ int     g_strcmp0                       (const char     *str1,
 void    g_assertion_message             (const char     *file,
                                          int             line,
                                          const char     *func,
-                                         const char     *message);
+                                         const char     *message)
+                                        G_GNUC_COLD G_GNUC_NOINLINE G_GNUC_NORETURN;
 
 void    g_assertion_message_expr        (const char     *file,
                                          int             line,
                                          const char     *func,
-                                         const char     *expr);
+                                         const char     *expr)
+                                        G_GNUC_COLD G_GNUC_NOINLINE G_GNUC_NORETURN;
 
 void    g_assertion_message_cmpnum      (const char     *file,
                                          int             line,
@@ -65,7 +102,12 @@ void    g_assertion_message_cmpnum      (const char     *file,
                                          long double     arg1,
                                          const char     *cmp,
                                          long double     arg2,
-                                         char            numtype);
+                                         char            numtype)
+                                        G_GNUC_COLD G_GNUC_NOINLINE G_GNUC_NORETURN;
+
+void    g_assertion_failed              (const char     *file,
+                                         int             line)
+                                        G_GNUC_COLD G_GNUC_NOINLINE G_GNUC_NORETURN;
 
 G_END_DECLS
 
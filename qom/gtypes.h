@@ -38,18 +38,25 @@ G_BEGIN_DECLS
  */
 
 // TODO glibconfig.h
+/* long has the width of a pointer on both ILP32 and LP64 targets, so
+ * it is used for the size types and the pointer <-> integer casts.
+ */
+typedef signed char gint8;
+typedef unsigned char guint8;
+typedef signed short gint16;
+typedef unsigned short guint16;
 typedef signed int gint32;
 typedef unsigned int guint32;
 typedef signed long long gint64;
 typedef unsigned long long guint64;
-typedef gint32  gssize;
-typedef guint32 gsize;
+typedef signed long   gssize;
+typedef unsigned long gsize;
 
-#define GPOINTER_TO_INT(p)	((gint)   (p))
-#define GPOINTER_TO_UINT(p)	((guint)  (p))
+#define GPOINTER_TO_INT(p)	((gint)   (glong) (p))
+#define GPOINTER_TO_UINT(p)	((guint)  (gulong) (p))
 
-#define GINT_TO_POINTER(i)	((gpointer)  (i))
-#define GUINT_TO_POINTER(u)	((gpointer)  (u))
+#define GINT_TO_POINTER(i)	((gpointer) (glong) (i))
+#define GUINT_TO_POINTER(u)	((gpointer) (gulong) (u))
 
 typedef char   gchar;
 typedef short  gshort;
@@ -8,89 +8,322 @@
  * See the COPYING file in the top-level directory.
  */
 
+#include <pthread.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "object.h"
+#include "object_int.h"
+#include "atomic.h"
+#include "cast_profile.h"
+#include "trace.h"
+#include "type_image.h"
 
-#define MAX_INTERFACES 32
+static Type type_interface;
+
+/* Bumped by every registration, to invalidate the caches of the registry. */
+static guint type_registry_generation;
+
+/* Set by type_registry_freeze(), after which TypeImpls and classes are
+ * read-only.
+ */
+static bool types_frozen;
 
-typedef struct InterfaceImpl InterfaceImpl;
-typedef struct TypeImpl TypeImpl;
+/* The largest instance size registered so far, under the table lock. */
+static size_t type_max_instance_size;
 
-struct InterfaceImpl
+size_t type_get_max_instance_size(void)
 {
-    const char *typename;
-};
+    return qatomic_read(&type_max_instance_size);
+}
+
+/*
+ * The type table is an open-addressing hash table of TypeImpls.  It is
+ * only changed under the write lock, and only by filling an empty slot,
+ * so lookups take no lock: they see a type either not at all or fully
+ * registered.  A full table is replaced by a copy twice its size.
+ * Lookups may still be probing the old one, and nothing tells when they
+ * are done, so replaced tables are kept; they add up to less than the
+ * current one.
+ *
+ * Code that walks the registry does not iterate the table but a snapshot
+ * of it, an immutable array of the types registered at some generation.
+ * Callbacks can then register types, and so can other threads, without
+ * invalidating the walk; new types show up in the next snapshot.
+ */
+static pthread_rwlock_t type_table_lock = PTHREAD_RWLOCK_INITIALIZER;
 
-struct TypeImpl
+typedef struct TypeTable
 {
-    const char *name;
+    guint size;
+    guint used;
+    struct TypeTable *replaced;
+    TypeImpl *slots[];
+} TypeTable;
+
+#define TYPE_TABLE_MIN_SIZE 64
 
-    size_t class_size;
+static TypeTable *type_table;
 
-    size_t instance_size;
+typedef struct TypeSnapshot
+{
+    int ref;
+    guint generation;
+    int num_types;
+    TypeImpl *types[];
+} TypeSnapshot;
 
-    void (*class_init)(ObjectClass *klass, void *data);
-    void (*class_base_init)(ObjectClass *klass, void *data);
-    void (*class_finalize)(ObjectClass *klass, void *data);
+static TypeTable *type_table_new(guint size)
+{
+    TypeTable *table;
 
-    void *class_data;
+    table = g_malloc0(sizeof(*table) + size * sizeof(table->slots[0]));
+    table->size = size;
 
-    void (*instance_init)(Object *obj);
-    void (*instance_finalize)(Object *obj);
+    return table;
+}
 
-    bool abstract;
+/* Returns the slot of @name in @table, or the empty slot it would go to. */
+static TypeImpl **type_table_find(TypeTable *table, const char *name)
+{
+    guint mask = table->size - 1;
+    guint i = g_str_hash(name) & mask;
+    TypeImpl *ti;
 
-    const char *parent;
-    TypeImpl *parent_type;
+    while ((ti = qatomic_load_acquire(&table->slots[i])) &&
+           strcmp(ti->hdr.name, name)) {
+        i = (i + 1) & mask;
+    }
 
-    ObjectClass *class;
+    return &table->slots[i];
+}
 
-    int num_interfaces;
-    InterfaceImpl interfaces[MAX_INTERFACES];
-};
+static TypeTable *type_table_grow(TypeTable *old)
+{
+    TypeTable *table;
+    guint i;
+
+    table = type_table_new(old ? old->size * 2 : TYPE_TABLE_MIN_SIZE);
+    for (i = 0; old && i < old->size; i++) {
+        if (old->slots[i]) {
+            *type_table_find(table, old->slots[i]->hdr.name) = old->slots[i];
+            table->used++;
+        }
+    }
+    table->replaced = old;
 
-static Type type_interface;
+    return table;
+}
 
-static GHashTable *type_table_get(void)
+/* The duplicate check is under the same lock as the insertion, so that
+ * of two threads registering the same name, one is sure to fail.
+ */
+static void type_table_add(TypeImpl *ti)
 {
-    static GHashTable *type_table;
+    TypeTable *table;
+    TypeImpl **slot;
+
+    pthread_rwlock_wrlock(&type_table_lock);
+    table = type_table;
+    if (!table || (table->used + 1) * 2 > table->size) {
+        table = type_table_grow(table);
+        qatomic_store_release(&type_table, table);
+    }
+
+    slot = type_table_find(table, ti->hdr.name);
+    if (*slot) {
+        fprintf(stderr, "Registering `%s' which already exists\n",
+                ti->hdr.name);
+        abort();
+    }
+    qatomic_store_release(slot, ti);
+    table->used++;
 
-    if (type_table == NULL) {
-        type_table = g_hash_table_new(g_str_hash, g_str_equal);
+    if (ti->instance_size > type_max_instance_size) {
+        qatomic_set(&type_max_instance_size, ti->instance_size);
     }
+    qatomic_inc(&type_registry_generation);
+    pthread_rwlock_unlock(&type_table_lock);
+}
+
+static TypeImpl *type_table_lookup(const char *name)
+{
+    TypeTable *table = qatomic_load_acquire(&type_table);
 
-    return type_table;
+    return table ? qatomic_load_acquire(type_table_find(table, name)) : NULL;
 }
 
-static bool enumerating_types;
+static TypeSnapshot *type_snapshot_new(int num_types)
+{
+    TypeSnapshot *snap;
 
-static void type_table_add(TypeImpl *ti)
+    snap = g_malloc(sizeof(*snap) + num_types * sizeof(snap->types[0]));
+    snap->ref = 1;
+    snap->num_types = 0;
+
+    return snap;
+}
+
+static void type_snapshot_unref(TypeSnapshot *snap)
 {
-    g_assert(!enumerating_types);
-    g_hash_table_insert(type_table_get(), (void *)ti->name, ti);
+    if (qatomic_fetch_dec(&snap->ref) == 1) {
+        g_free(snap);
+    }
 }
 
-static TypeImpl *type_table_lookup(const char *name)
+/* Returns a snapshot of all registered types. */
+static TypeSnapshot *type_table_snapshot(void)
+{
+    TypeSnapshot *snap;
+    guint i;
+
+    pthread_rwlock_rdlock(&type_table_lock);
+    snap = type_snapshot_new(type_table ? type_table->used : 0);
+    snap->generation = type_registry_generation;
+    for (i = 0; type_table && i < type_table->size; i++) {
+        if (type_table->slots[i]) {
+            snap->types[snap->num_types++] = type_table->slots[i];
+        }
+    }
+    pthread_rwlock_unlock(&type_table_lock);
+
+    return snap;
+}
+
+/*
+ * Class structs and TypeImpls are carved out of an arena of page-aligned
+ * chunks instead of getting one malloc block each.  Classes initialized
+ * one after the other, in particular by type_initialize_all(), end up
+ * next to each other, and type_registry_freeze() write-protects whole
+ * chunks.
+ */
+#define TYPE_ARENA_CHUNK_SIZE (64 * 1024)
+#define TYPE_ARENA_ALIGN 16
+#define TYPE_ARENA_ROUND(n, align) (((n) + (align) - 1) & ~((size_t)(align) - 1))
+
+typedef struct TypeArenaChunk TypeArenaChunk;
+
+struct TypeArenaChunk
+{
+    TypeArenaChunk *next;
+    size_t size;
+    size_t used;
+};
+
+static TypeArenaChunk *type_arena;
+static pthread_mutex_t type_arena_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *type_arena_alloc(size_t size)
+{
+    TypeArenaChunk *chunk;
+    size_t header = TYPE_ARENA_ROUND(sizeof(*chunk), TYPE_ARENA_ALIGN);
+    void *p;
+
+    size = TYPE_ARENA_ROUND(size, TYPE_ARENA_ALIGN);
+    pthread_mutex_lock(&type_arena_lock);
+    chunk = type_arena;
+    if (!chunk || chunk->used + size > chunk->size) {
+        size_t chunk_size = TYPE_ARENA_ROUND(MAX(TYPE_ARENA_CHUNK_SIZE,
+                                                  header + size),
+                                              sysconf(_SC_PAGESIZE));
+
+        /* Whole pages, so that no other allocation shares them. */
+        if (posix_memalign(&p, sysconf(_SC_PAGESIZE), chunk_size) != 0) {
+            fprintf(stderr, "failed to allocate %lu bytes of types\n",
+                    (unsigned long)chunk_size);
+            abort();
+        }
+        memset(p, 0, chunk_size);
+
+        chunk = p;
+        chunk->next = type_arena;
+        chunk->size = chunk_size;
+        chunk->used = header;
+        type_arena = chunk;
+    }
+
+    p = (char *)chunk + chunk->used;
+    chunk->used += size;
+    pthread_mutex_unlock(&type_arena_lock);
+
+    return p;
+}
+
+static void type_arena_protect(void)
+{
+    TypeArenaChunk *chunk, *next;
+
+    for (chunk = type_arena; chunk; chunk = next) {
+        next = chunk->next;
+        if (mprotect(chunk, chunk->size, PROT_READ) != 0) {
+            perror("mprotect");
+            abort();
+        }
+    }
+}
+
+/*
+ * A type only uses the ancestry bitset of its image entry if it has the
+ * same parent as in the image, and that parent uses its own bitset: then
+ * by induction the whole chain of ancestors matches the image.  Parents
+ * registered after their children miss out on the bitset, which is
+ * merely slower.
+ */
+static bool type_image_bind_ok(const TypeImageEntry *entry,
+                               const TypeInfo *info)
 {
-    return g_hash_table_lookup(type_table_get(), name);
+    TypeImpl *parent;
+
+    if (!type_image_entry_matches(entry, info)) {
+        return false;
+    }
+
+    if (!info->parent) {
+        return true;
+    }
+
+    /* Image names are unique, so a bound parent is bound to our parent
+     * entry.
+     */
+    parent = type_table_lookup(info->parent);
+    return parent && parent->ancestry;
 }
 
 static TypeImpl *type_new(const TypeInfo *info)
 {
-    TypeImpl *ti = g_malloc0(sizeof(*ti));
+    const TypeImageEntry *entry;
+    pthread_mutexattr_t attr;
+    TypeImpl *ti;
     int i;
 
     g_assert(info->name != NULL);
 
-    if (type_table_lookup(info->name) != NULL) {
-        fprintf(stderr, "Registering `%s' which already exists\n", info->name);
+    if (qatomic_read(&types_frozen)) {
+        fprintf(stderr, "Registering `%s' after the type registry was frozen\n",
+                info->name);
         abort();
     }
 
-    ti->name = g_strdup(info->name);
-    ti->parent = g_strdup(info->parent);
+    ti = type_arena_alloc(sizeof(*ti));
+
+    /* Type names are interned: the same parent and interface names are
+     * shared by many types, and interned names can be compared by pointer.
+     * Names from the mapped type image need not even be copied.
+     */
+    entry = type_image_lookup(info->name);
+    if (entry && type_image_bind_ok(entry, info)) {
+        ti->hdr.name = g_intern_static_string(type_image_entry_name(entry));
+        ti->parent = g_intern_static_string(type_image_entry_parent(entry));
+        ti->image_index = type_image_entry_index(entry);
+        ti->ancestry = type_image_entry_ancestry(entry);
+    } else {
+        ti->hdr.name = g_intern_string(info->name);
+        ti->parent = g_intern_string(info->parent);
+    }
 
     ti->class_size = info->class_size;
     ti->instance_size = info->instance_size;
@@ -103,11 +336,36 @@ static TypeImpl *type_new(const TypeInfo *info)
     ti->instance_init = info->instance_init;
     ti->instance_finalize = info->instance_finalize;
 
-    ti->abstract = info->abstract;
+    ti->version = info->version;
+    ti->save = info->save;
+    ti->load = info->load;
+
+    ti->copy_fields = info->copy_fields;
+    ti->instance_copy = info->instance_copy;
+
+    /* The prototype is built by the first object_new(), after
+     * type_registry_freeze() may have protected the type.
+     */
+    if (info->prototype) {
+        ti->prototype = g_new0(TypePrototype, 1);
+        pthread_mutex_init(&ti->prototype->lock, NULL);
+    }
+    ti->instance_post_copy = info->instance_post_copy;
+
+    ti->hdr.abstract = info->abstract;
+    ti->hdr.final = info->final;
+    /* Statistics change with every instance, keep them off the type pages. */
+    ti->stats = g_malloc0(sizeof(*ti->stats));
+    ti->stats->name = ti->hdr.name;
+    ti->cast_cache = g_new0(TypeCastCache, 1);
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&ti->class_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
     
     /* Warining the interfaces array should have a sentinel NULL*/
     for (i = 0; info->interfaces && info->interfaces[i].type; i++) {
-        ti->interfaces[i].typename = g_strdup(info->interfaces[i].type);
+        ti->interfaces[i].typename = g_intern_string(info->interfaces[i].type);
     }
     ti->num_interfaces = i;
 
@@ -116,12 +374,28 @@ static TypeImpl *type_new(const TypeInfo *info)
 
 static void type_initialize(TypeImpl *ti);
 
+static void type_check_parent_not_final(TypeImpl *ti, TypeImpl *parent)
+{
+    if (parent && parent->hdr.final) {
+        fprintf(stderr, "Registering `%s' derived from final type `%s'\n",
+                ti->hdr.name, parent->hdr.name);
+        abort();
+    }
+}
+
 static TypeImpl *type_register_internal(const TypeInfo *info)
 {
     TypeImpl *ti;
 
     ti = type_new(info);
+    /* The parent may also be registered after its children, in which case
+     * type_initialize() catches the violation.
+     */
+    if (ti->parent) {
+        type_check_parent_not_final(ti, type_table_lookup(ti->parent));
+    }
     type_table_add(ti);
+    trace_type_register(ti->hdr.name);
     
     if (info->type_init_phase == TYPE_REGISTER_PHASE) {
        type_initialize(ti); 
@@ -167,11 +441,13 @@ void *get_class_by_name(const char *typename,
     g_assert(typename != NULL);
     
     TypeImpl *ti = type_get_by_name(typename);
+    ObjectClass *class;
 
     /* Check whether type has registered already. */
     g_assert(ti != NULL);
     
-    if (ti->class == NULL) {
+    class = qatomic_load_acquire(&ti->class);
+    if (class == NULL) {
         fprintf(stderr, "%s:%d:%s: type %s is uninitialized, you may call new\
                 function to create a object first or set type_init_phase to \
                 TYPE_REGISTER_PHASE in %s_type_info before get a class.\n",
@@ -179,17 +455,21 @@ void *get_class_by_name(const char *typename,
         abort(); 
     }
     
-    return ti->class;
+    return class;
 }
 
 static TypeImpl *type_get_parent(TypeImpl *type)
 {
-    if (!type->parent_type && type->parent) {
-        type->parent_type = type_get_by_name(type->parent);
-        g_assert(type->parent_type != NULL);
+    TypeImpl *parent = qatomic_read(&type->parent_type);
+
+    /* Racing threads all store the same pointer. */
+    if (!parent && type->parent) {
+        parent = type_get_by_name(type->parent);
+        g_assert(parent != NULL);
+        qatomic_set(&type->parent_type, parent);
     }
 
-    return type->parent_type;
+    return parent;
 }
 
 static bool type_has_parent(TypeImpl *type)
@@ -235,6 +515,12 @@ static bool type_is_ancestor(TypeImpl *type, TypeImpl *target_type)
 {
     g_assert(target_type);
 
+    if (type && type->ancestry && target_type->ancestry) {
+        int i = target_type->image_index;
+
+        return (type->ancestry[i / 64] >> (i % 64)) & 1;
+    }
+
     /* Check if target_type is a direct ancestor of type */
     while (type) {
         if (type == target_type) {
@@ -265,7 +551,9 @@ bool is_compatible_type(const char *typename, const char *target_typename)
 
 static void type_initialize(TypeImpl *ti);
 
-static void type_initialize_interface(TypeImpl *ti, TypeImpl *interface_type,
+/* Add a class of @interface_type to @class, the class being built for @ti. */
+static void type_initialize_interface(TypeImpl *ti, ObjectClass *class,
+                                      TypeImpl *interface_type,
                                       TypeImpl *parent_type)
 {
     InterfaceClass *new_iface;
@@ -273,33 +561,127 @@ static void type_initialize_interface(TypeImpl *ti, TypeImpl *interface_type,
     /* Remove warning -Wmissing-field-initializers */
     TypeInfo info = {.type_init_phase=OBJECT_NEW_PHASE};
     TypeImpl *iface_impl;
+    char name_buf[128];
+    char *name = NULL;
+    int len;
+
+    /* type_new() interns the name, so a stack buffer is enough unless
+     * the synthesized name is unusually long.
+     */
+    len = g_snprintf(name_buf, sizeof(name_buf), "%s::%s",
+                     ti->hdr.name, interface_type->hdr.name);
+    if (len >= 0 && len < (int)sizeof(name_buf)) {
+        info.name = name_buf;
+    } else {
+        name = g_strdup_printf("%s::%s", ti->hdr.name,
+                               interface_type->hdr.name);
+        info.name = name;
+    }
 
-    info.parent = parent_type->name;
-    info.name = g_strdup_printf("%s::%s", ti->name, interface_type->name);
+    info.parent = parent_type->hdr.name;
     info.abstract = true;
 
     iface_impl = type_new(&info);
     iface_impl->parent_type = parent_type;
     type_initialize(iface_impl);
-    g_free((char *)info.name);
+    g_free(name);
 
     new_iface = (InterfaceClass *)iface_impl->class;
-    new_iface->concrete_class = ti->class;
+    new_iface->concrete_class = class;
     new_iface->interface_type = interface_type;
 
-    ti->class->interfaces = g_slist_append(ti->class->interfaces,
-                                           iface_impl->class);
+    class->interfaces = g_slist_append(class->interfaces, iface_impl->class);
 }
 
 
+/* Append the hook of @ti to the hooks of its parent, or prepend it if
+ * @leaf_first, and return the new number of hooks.
+ */
+static int type_chain_hooks(ObjectInstanceHook **hooks,
+                            ObjectInstanceHook *const *parent_hooks,
+                            int num_parent_hooks, ObjectInstanceHook *hook,
+                            bool leaf_first)
+{
+    int n = 0;
+
+    if (hook && leaf_first) {
+        hooks[n++] = hook;
+    }
+    if (num_parent_hooks) {
+        memcpy(hooks + n, parent_hooks, num_parent_hooks * sizeof(*hooks));
+        n += num_parent_hooks;
+    }
+    if (hook && !leaf_first) {
+        hooks[n++] = hook;
+    }
+
+    return n;
+}
+
+static void type_initialize_hooks(TypeImpl *ti)
+{
+    TypeImpl *parent = type_get_parent(ti);
+    static const TypeImpl no_parent;
+    const TypeImpl *p = parent ? parent : &no_parent;
+    ObjectInstanceHook **hooks;
+
+    hooks = type_arena_alloc((p->num_init_hooks + p->num_post_copy_hooks +
+                              p->num_finalize_hooks + 3) * sizeof(*hooks));
+
+    ti->init_hooks = hooks;
+    ti->num_init_hooks = type_chain_hooks(hooks, p->init_hooks,
+                                          p->num_init_hooks,
+                                          ti->instance_init, false);
+    hooks += ti->num_init_hooks;
+
+    ti->post_copy_hooks = hooks;
+    ti->num_post_copy_hooks = type_chain_hooks(hooks, p->post_copy_hooks,
+                                               p->num_post_copy_hooks,
+                                               ti->instance_post_copy, false);
+    hooks += ti->num_post_copy_hooks;
+
+    ti->finalize_hooks = hooks;
+    ti->num_finalize_hooks = type_chain_hooks(hooks, p->finalize_hooks,
+                                              p->num_finalize_hooks,
+                                              ti->instance_finalize, true);
+}
 
+/*
+ * Classes are built under the class lock of their type and only published
+ * in TypeImpl.class once complete, so that a thread that finds the class
+ * can use it right away.  The lock is recursive only to catch a class
+ * that is needed during its own initialization.
+ */
 static void type_initialize(TypeImpl *ti)
 {
     TypeImpl *parent;
+    ObjectClass *class;
+
+    if (qatomic_load_acquire(&ti->class)) {
+        return;
+    }
+
+    /* If the derived class instance is created by calling object_new
+     * the parent class then is uninitalized, so it is necessary to
+     * initialize the parent first.
+     */
+    parent = type_get_parent(ti);
+    type_check_parent_not_final(ti, parent);
+    if (parent) {
+        type_initialize(parent);
+    }
 
+    pthread_mutex_lock(&ti->class_lock);
     if (ti->class) {
+        pthread_mutex_unlock(&ti->class_lock);
         return;
     }
+    if (ti->class_initializing) {
+        fprintf(stderr, "Class of `%s' used during its own initialization\n",
+                ti->hdr.name);
+        abort();
+    }
+    ti->class_initializing = true;
 
     ti->class_size = type_class_get_size(ti);
     ti->instance_size = type_object_get_size(ti);
@@ -307,18 +689,12 @@ static void type_initialize(TypeImpl *ti)
      * This means interface types are all abstract.
      */
     if (ti->instance_size == 0) {
-        ti->abstract = true;
+        ti->hdr.abstract = true;
     }
 
-    ti->class = g_malloc0(ti->class_size);
+    class = type_arena_alloc(ti->class_size);
 
-    parent = type_get_parent(ti);
     if (parent) {
-        /* If the derived class instance is created by calling object_new
-         * the parent class then is uninitalized, so it is necessary to 
-         * initialize the parent first.
-         */
-        type_initialize(parent);
         GSList *e;
         int i;
 
@@ -327,28 +703,29 @@ static void type_initialize(TypeImpl *ti)
         /* Important action, copy the class struct of parent, every derived
          * class has a unique copy of the class struct of their parent.
          */
-        memcpy(ti->class, parent->class, parent->class_size);
+        memcpy(class, parent->class, parent->class_size);
 
         /* When initialized, it keeps interfaces both from parent and
          * its own.
          */
-        ti->class->interfaces = NULL;
+        class->interfaces = NULL;
 
-        ti->class->properties = g_hash_table_new_full(
-            g_str_hash, g_str_equal, g_free, NULL);
+        /* Class property tables are created on first use. */
+        class->properties = NULL;
 
         /* interfaces from parent */
         for (e = parent->class->interfaces; e; e = e->next) {
             InterfaceClass *iface = e->data;
             ObjectClass *klass = OBJECT_CLASS(iface);
 
-            type_initialize_interface(ti, iface->interface_type, klass->type);
+            type_initialize_interface(ti, class, iface->interface_type,
+                                      klass->type);
         }
 
         /* interfaces from the type its own */
         for (i = 0; i < ti->num_interfaces; i++) {
             TypeImpl *t = type_get_by_name(ti->interfaces[i].typename);
-            for (e = ti->class->interfaces; e; e = e->next) {
+            for (e = class->interfaces; e; e = e->next) {
                 TypeImpl *target_type = OBJECT_CLASS(e->data)->type;
 
                 if (type_is_ancestor(target_type, t)) {
@@ -360,220 +737,1149 @@ static void type_initialize(TypeImpl *ti)
                 continue;
             }
 
-            type_initialize_interface(ti, t, t);
+            type_initialize_interface(ti, class, t, t);
         }
-    } else {
-        ti->class->properties = g_hash_table_new_full(
-            g_str_hash, g_str_equal, g_free, NULL);
     }
 
-    ti->class->type = ti;
+    class->type = ti;
 
     while (parent) {
         if (parent->class_base_init) {
-            parent->class_base_init(ti->class, ti->class_data);
+            parent->class_base_init(class, ti->class_data);
         }
         parent = type_get_parent(parent);
     }
 
     if (ti->class_init) {
-        ti->class_init(ti->class, ti->class_data);
+        trace_class_init_start(ti->hdr.name, class);
+        ti->class_init(class, ti->class_data);
+        trace_class_init_end(ti->hdr.name, class);
     }
-}
 
-static void object_init_with_type(Object *obj, TypeImpl *ti)
-{
-    if (type_has_parent(ti)) {
-        object_init_with_type(obj, type_get_parent(ti));
-    }
+    type_initialize_hooks(ti);
 
-    if (ti->instance_init) {
-        ti->instance_init(obj);
-    }
+    qatomic_store_release(&ti->class, class);
+    ti->class_initializing = false;
+    pthread_mutex_unlock(&ti->class_lock);
 }
 
+typedef struct TypeTreeData
+{
+    GSList *roots;
+    GHashTable *children;
+} TypeTreeData;
 
-static void object_initialize_with_type(void *data, size_t size, TypeImpl *type)
+static void type_tree_add(gpointer key, gpointer value, gpointer opaque)
 {
-    Object *obj = data;
+    TypeTreeData *data = opaque;
+    TypeImpl *ti = value;
+    GSList *siblings;
 
-    g_assert(type != NULL);
-    type_initialize(type);
+    if (!ti->parent) {
+        data->roots = g_slist_prepend(data->roots, ti);
+        return;
+    }
 
-    g_assert_cmpint(type->instance_size, >=, sizeof(Object));
-    g_assert(type->abstract == false);
-    g_assert_cmpint(size, >=, type->instance_size);
+    /* Type names are interned, so the parent name is a good pointer key. */
+    siblings = g_hash_table_lookup(data->children, ti->parent);
+    g_hash_table_insert(data->children, (void *)ti->parent,
+                        g_slist_prepend(siblings, ti));
+}
 
-    memset(obj, 0, type->instance_size);
-    obj->class = type->class;
-    object_ref(obj);
-    obj->properties = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                            NULL, NULL);
-    object_init_with_type(obj, type);
+static void type_tree_free_children(gpointer key, gpointer value,
+                                    gpointer opaque)
+{
+    g_slist_free(value);
 }
 
-void object_initialize(void *data, size_t size, const char *typename)
+static void type_initialize_subtree(TypeImpl *ti, GHashTable *children)
 {
-    TypeImpl *type = type_get_by_name(typename);
+    GSList *l;
 
-    object_initialize_with_type(data, size, type);
+    type_initialize(ti);
+
+    for (l = g_hash_table_lookup(children, ti->hdr.name); l; l = l->next) {
+        type_initialize_subtree(l->data, children);
+    }
 }
 
-static void object_deinit(Object *obj, TypeImpl *type)
+void type_initialize_all(void)
 {
-    if (type->instance_finalize) {
-        type->instance_finalize(obj);
+    TypeTreeData data = { NULL, g_hash_table_new(NULL, NULL) };
+    TypeSnapshot *snap = type_table_snapshot();
+    GSList *l;
+    int i;
+
+    for (i = 0; i < snap->num_types; i++) {
+        type_tree_add(NULL, snap->types[i], &data);
     }
+    type_snapshot_unref(snap);
 
-    if (type_has_parent(type)) {
-        object_deinit(obj, type_get_parent(type));
+    for (l = data.roots; l; l = l->next) {
+        type_initialize_subtree(l->data, data.children);
     }
+
+    g_hash_table_foreach(data.children, type_tree_free_children, NULL);
+    g_hash_table_destroy(data.children);
+    g_slist_free(data.roots);
 }
 
-static void object_finalize(void *data)
+void type_registry_freeze(void)
 {
-    Object *obj = data;
-    TypeImpl *ti = obj->class->type;
+    if (qatomic_read(&types_frozen)) {
+        return;
+    }
 
-    object_deinit(obj, ti);
+    type_initialize_all();
+    qatomic_set(&types_frozen, true);
+    type_arena_protect();
+}
 
-    g_assert_cmpint(obj->ref, ==, 0);
-    if (obj->free) {
-        obj->free(obj);
-    }
+bool type_registry_is_frozen(void)
+{
+    return qatomic_read(&types_frozen);
 }
 
-static Object *object_new_with_type(Type type)
+static void object_init_with_type(Object *obj, TypeImpl *ti)
 {
-    Object *obj;
+    int i;
 
-    g_assert(type != NULL);
-    type_initialize(type);
+    for (i = 0; i < ti->num_init_hooks; i++) {
+        ti->init_hooks[i](obj);
+    }
+}
 
-    obj = g_malloc(type->instance_size);
-    object_initialize_with_type(obj, type->instance_size, type);
-    obj->free = g_free;
 
-    return obj;
+static bool stats_timing;
+
+void qom_stats_set_timing(bool enable)
+{
+    qatomic_set(&stats_timing, enable);
 }
 
-Object *object_new(const char *typename)
+static guint64 stats_clock_read(void)
 {
-    TypeImpl *ti = type_get_by_name(typename);
+    struct timespec ts;
 
-    return object_new_with_type(ti);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 }
 
-Object *object_dynamic_cast(Object *obj, const char *typename)
+/* Returns a start time, or 0 if timing is disabled.  Once a start time
+ * was taken, the end time is read with stats_clock_read() even if timing
+ * was disabled meanwhile.
+ */
+static guint64 stats_clock_ns(void)
 {
-    if (obj && object_class_dynamic_cast(object_get_class(obj), typename)) {
-        return obj;
+    if (G_LIKELY(!qatomic_read(&stats_timing))) {
+        return 0;
     }
 
-    return NULL;
+    return stats_clock_read();
 }
 
-Object *object_dynamic_cast_assert(Object *obj, const char *typename,
-                                   const char *file, int line, const char *func)
+static void type_stats_created(TypeImpl *type, guint64 init_start)
 {
-    g_assert(obj != NULL);
+    ObjectTypeStats *stats = type->stats;
+    guint64 alive, peak, old;
+
+    qatomic_inc(&stats->created);
+    qatomic_add(&stats->bytes, type->instance_size);
+    alive = qatomic_fetch_inc(&stats->alive) + 1;
+
+    peak = qatomic_read(&stats->peak);
+    while (alive > peak) {
+        old = qatomic_cmpxchg(&stats->peak, peak, alive);
+        if (old == peak) {
+            break;
+        }
+        peak = old;
+    }
 
-    return obj;
+    if (init_start) {
+        qatomic_add(&stats->init_ns, stats_clock_read() - init_start);
+    }
 }
 
-ObjectClass *object_class_dynamic_cast(ObjectClass *class,
-                                       const char *typename)
+static void type_stats_finalized(TypeImpl *type, guint64 finalize_start)
 {
-    ObjectClass *ret = NULL;
-    TypeImpl *target_type;
-    TypeImpl *type;
-
-    if (!class) {
-        return NULL;
-    }
+    ObjectTypeStats *stats = type->stats;
 
-    /* A simple fast path that can trigger a lot for leaf classes.  */
-    type = class->type;
-    if (type->name == typename) {
-        return class;
-    }
+    qatomic_dec(&stats->alive);
+    qatomic_sub(&stats->bytes, type->instance_size);
 
-    target_type = type_get_by_name(typename);
-    if (!target_type) {
-        /* target class type unknown, so fail the cast */
-        return NULL;
+    if (finalize_start) {
+        qatomic_add(&stats->finalize_ns,
+                    stats_clock_read() - finalize_start);
     }
+}
 
-    /* If the type_interface is the ancestor of the target_type to be cast,
-     * then we iterate through the interfaces to find the target class.
-     * Otherwise, we just check whether the target_type is the ancestor of 
-     * the type.
-     */
-    if (type->class->interfaces &&
-            type_is_ancestor(target_type, type_interface)) {
-        int found = 0;
-        GSList *i;
-
-        for (i = class->interfaces; i; i = i->next) {
-            ObjectClass *target_class = i->data;
+typedef struct ObjectChildLookup {
+    Object *child;
+    const char *name;
+} ObjectChildLookup;
 
-            if (type_is_ancestor(target_class->type, target_type)) {
-                ret = target_class;
-                found++;
-            }
-         }
+static int object_find_child_name(const char *name, Object *target,
+                                  bool child, void *opaque)
+{
+    ObjectChildLookup *lookup = opaque;
 
-        /* The match was ambiguous, don't allow a cast */
-        if (found > 1) {
-            ret = NULL;
-        }
-    } else if (type_is_ancestor(type, target_type)) {
-        ret = class;
+    if (child && target == lookup->child) {
+        lookup->name = name;
+        return 1;
     }
 
-    return ret;
+    return 0;
 }
 
-ObjectClass *object_class_dynamic_cast_assert(ObjectClass *class,
-                                              const char *typename,
-                                              const char *file,
-                                              int line,
-                                              const char *func)
+/* Returns the copy in @dst of @child, a child of @src. */
+static Object *object_copy_child(Object *dst, Object *src, Object *child)
 {
+    ObjectChildLookup lookup = { child };
+
+    object_property_foreach(src, object_find_child_name, &lookup);
+    g_assert(lookup.name != NULL);
+
+    return object_property_get_child(dst, lookup.name);
+}
+
+static void object_copy_with_type(Object *dst, Object *src, TypeImpl *ti)
+{
+    const ObjectCopyField *f;
+
+    if (type_has_parent(ti)) {
+        object_copy_with_type(dst, src, type_get_parent(ti));
+    }
+
+    for (f = ti->copy_fields; f && f->kind != OBJECT_COPY_END; f++) {
+        void **field = (void **)((char *)dst + f->offset);
+
+        switch (f->kind) {
+        case OBJECT_COPY_STRING:
+            *field = g_strdup(*field);
+            break;
+        case OBJECT_COPY_REF:
+            if (*field) {
+                object_ref(*field);
+            }
+            break;
+        case OBJECT_COPY_CLONE:
+            if (*field) {
+                *field = object_clone(*field);
+            }
+            break;
+        case OBJECT_COPY_NULL:
+            *field = NULL;
+            break;
+        case OBJECT_COPY_CHILD:
+            if (*field) {
+                *field = object_copy_child(dst, src, *field);
+            }
+            break;
+        default:
+            g_assert_not_reached();
+        }
+    }
+
+    if (ti->instance_copy) {
+        ti->instance_copy(dst, src);
+    }
+}
+
+static int object_copy_property(const char *name, Object *target,
+                                bool child, void *opaque)
+{
+    Object *dst = opaque, *copy;
+
+    if (child) {
+        copy = object_clone(target);
+        object_property_add_child(dst, name, copy, &error_abort);
+        object_unref(copy);
+    } else {
+        object_property_add_link(dst, name, target, &error_abort);
+    }
+
+    return 0;
+}
+
+/* Initialize @dst as a copy of @src, both of type @type. */
+static void object_copy_instance(Object *dst, Object *src, TypeImpl *type)
+{
+    memcpy(dst, src, type->instance_size);
+
+    /* Only the Object header is per instance. */
+    dst->free = NULL;
+    dst->ref = 1;
+    dst->has_weak_refs = false;
+    dst->parent = NULL;
+    dst->child_name = NULL;
+    dst->properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                            NULL, NULL);
+
+    /* The properties come first, for OBJECT_COPY_CHILD. */
+    if (g_hash_table_size(src->properties)) {
+        object_property_foreach(src, object_copy_property, dst);
+    }
+    object_copy_with_type(dst, src, type);
+}
+
+static void object_post_copy_with_type(Object *obj, TypeImpl *ti)
+{
+    int i;
+
+    for (i = 0; i < ti->num_post_copy_hooks; i++) {
+        ti->post_copy_hooks[i](obj);
+    }
+}
+
+static void object_init_instance(Object *obj, TypeImpl *type)
+{
+    memset(obj, 0, type->instance_size);
+    obj->class = type->class;
+    object_ref(obj);
+    obj->properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                            NULL, NULL);
+    object_init_with_type(obj, type);
+}
+
+static void object_deinit(Object *obj, TypeImpl *type);
+static void object_property_del_all(Object *obj);
+
+/*
+ * Returns the prototype of @type, building it on first use, or %NULL if
+ * objects of @type run instance_init.  A prototype that instance_init
+ * gave properties is dropped: copies would get clones of its children,
+ * while pointers to them in the instance would still point to the
+ * originals.
+ */
+static Object *type_get_prototype(TypeImpl *type)
+{
+    TypePrototype *p = type->prototype;
+    Object *proto = qatomic_load_acquire(&p->obj);
+
+    if (G_LIKELY(proto) || qatomic_read(&p->disabled)) {
+        return proto;
+    }
+
+    pthread_mutex_lock(&p->lock);
+    if (!p->obj && !p->disabled) {
+        proto = g_malloc(type->instance_size);
+        object_init_instance(proto, type);
+        if (g_hash_table_size(proto->properties)) {
+            object_property_del_all(proto);
+            object_deinit(proto, type);
+            g_hash_table_unref(proto->properties);
+            g_free(proto);
+            qatomic_set(&p->disabled, true);
+        } else {
+            qatomic_store_release(&p->obj, proto);
+        }
+    }
+    proto = p->obj;
+    pthread_mutex_unlock(&p->lock);
+
+    return proto;
+}
+
+static void object_initialize_with_type(void *data, size_t size, TypeImpl *type)
+{
+    Object *obj = data, *proto;
+    guint64 init_start;
+
+    g_assert(type != NULL);
+    type_initialize(type);
+
+    g_assert_cmpint(type->instance_size, >=, sizeof(Object));
+    g_assert(type->hdr.abstract == false);
+    g_assert_cmpint(size, >=, type->instance_size);
+
+    init_start = stats_clock_ns();
+    proto = type->prototype ? type_get_prototype(type) : NULL;
+    if (proto) {
+        object_copy_instance(obj, proto, type);
+        object_post_copy_with_type(obj, type);
+    } else {
+        object_init_instance(obj, type);
+    }
+    type_stats_created(type, init_start);
+    trace_object_init(type->hdr.name, obj);
+}
+
+void object_initialize(void *data, size_t size, const char *typename)
+{
+    TypeImpl *type = type_get_by_name(typename);
+
+    object_initialize_with_type(data, size, type);
+}
+
+static void object_deinit(Object *obj, TypeImpl *type)
+{
+    int i;
+
+    for (i = 0; i < type->num_finalize_hooks; i++) {
+        type->finalize_hooks[i](obj);
+    }
+}
+
+/*
+ * Child and link properties, keyed by name in Object.properties.
+ */
+typedef enum ObjectPropertyKind {
+    OBJECT_PROPERTY_CHILD,
+    OBJECT_PROPERTY_LINK,
+} ObjectPropertyKind;
+
+typedef struct ObjectProperty {
+    char *name;
+    ObjectPropertyKind kind;
+    Object *target;
+} ObjectProperty;
+
+/*
+ * The canonical path index.  object_paths maps the path of every object
+ * attached to the root to the object, and object_path_names maps the
+ * object back to the same string, which object_paths owns.  The tree
+ * itself is not thread-safe, but the index is shared by all trees below
+ * the root, so object_paths_lock guards it and the creation of the root.
+ */
+static pthread_mutex_t object_paths_lock = PTHREAD_MUTEX_INITIALIZER;
+static Object *object_root;
+static GHashTable *object_paths;
+static GHashTable *object_path_names;
+
+static char *object_path_join(const char *path, const char *name)
+{
+    return g_strdup_printf("%s/%s", strcmp(path, "/") ? path : "", name);
+}
+
+static void object_path_index_add(Object *obj, char *path)
+{
+    GHashTableIter iter;
+    ObjectProperty *prop;
+
+    g_hash_table_insert(object_paths, path, obj);
+    g_hash_table_insert(object_path_names, obj, path);
+
+    g_hash_table_iter_init(&iter, obj->properties);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&prop)) {
+        if (prop->kind == OBJECT_PROPERTY_CHILD) {
+            object_path_index_add(prop->target,
+                                  object_path_join(path, prop->name));
+        }
+    }
+}
+
+static void object_path_index_remove(Object *obj)
+{
+    GHashTableIter iter;
+    ObjectProperty *prop;
+    char *path;
+
+    path = object_path_names ? g_hash_table_lookup(object_path_names, obj)
+                             : NULL;
+    if (!path) {
+        return;
+    }
+
+    g_hash_table_iter_init(&iter, obj->properties);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&prop)) {
+        if (prop->kind == OBJECT_PROPERTY_CHILD) {
+            object_path_index_remove(prop->target);
+        }
+    }
+
+    g_hash_table_remove(object_path_names, obj);
+    g_hash_table_remove(object_paths, path);
+}
+
+static ObjectProperty *object_property_add(Object *obj, const char *name,
+                                           ObjectPropertyKind kind,
+                                           Object *target, Error **errp)
+{
+    ObjectProperty *prop;
+
+    if (strchr(name, '/')) {
+        error_setg(errp, "invalid property name '%s'", name);
+        return NULL;
+    }
+
+    if (g_hash_table_contains(obj->properties, name)) {
+        error_setg(errp, "attempt to add duplicate property '%s'"
+                   " to object (type '%s')", name, object_get_typename(obj));
+        return NULL;
+    }
+
+    prop = g_new(ObjectProperty, 1);
+    prop->name = g_strdup(name);
+    prop->kind = kind;
+    prop->target = target;
+    g_hash_table_insert(obj->properties, prop->name, prop);
+    object_ref(target);
+
+    return prop;
+}
+
+void object_property_add_child(Object *obj, const char *name, Object *child,
+                               Error **errp)
+{
+    ObjectProperty *prop;
+    Object *o;
+    char *path;
+
+    if (child->parent) {
+        error_setg(errp, "object of type '%s' already has a parent",
+                   object_get_typename(child));
+        return;
+    }
+
+    for (o = obj; o; o = o->parent) {
+        if (o == child) {
+            error_setg(errp, "object of type '%s' cannot be its own"
+                       " descendant", object_get_typename(child));
+            return;
+        }
+    }
+
+    prop = object_property_add(obj, name, OBJECT_PROPERTY_CHILD, child, errp);
+    if (!prop) {
+        return;
+    }
+    child->parent = obj;
+    child->child_name = prop->name;
+
+    pthread_mutex_lock(&object_paths_lock);
+    path = object_path_names ? g_hash_table_lookup(object_path_names, obj)
+                             : NULL;
+    if (path) {
+        object_path_index_add(child, object_path_join(path, name));
+    }
+    pthread_mutex_unlock(&object_paths_lock);
+}
+
+void object_property_add_link(Object *obj, const char *name, Object *target,
+                              Error **errp)
+{
+    object_property_add(obj, name, OBJECT_PROPERTY_LINK, target, errp);
+}
+
+static void object_property_release(ObjectProperty *prop)
+{
+    Object *target = prop->target;
+
+    if (prop->kind == OBJECT_PROPERTY_CHILD) {
+        if (target->class->unparent) {
+            target->class->unparent(target);
+        }
+        pthread_mutex_lock(&object_paths_lock);
+        object_path_index_remove(target);
+        pthread_mutex_unlock(&object_paths_lock);
+        target->parent = NULL;
+        target->child_name = NULL;
+    }
+
+    g_free(prop->name);
+    g_free(prop);
+    object_unref(target);
+}
+
+void object_property_del(Object *obj, const char *name)
+{
+    ObjectProperty *prop = g_hash_table_lookup(obj->properties, name);
+
+    if (!prop) {
+        return;
+    }
+
+    g_hash_table_steal(obj->properties, name);
+    object_property_release(prop);
+}
+
+static void object_property_del_all(Object *obj)
+{
+    GHashTableIter iter;
+    ObjectProperty *prop;
+
+    g_hash_table_iter_init(&iter, obj->properties);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&prop)) {
+        g_hash_table_iter_steal(&iter);
+        object_property_release(prop);
+    }
+}
+
+void object_unparent(Object *obj)
+{
+    if (obj->parent) {
+        object_property_del(obj->parent, obj->child_name);
+    }
+}
+
+Object *object_get_root(void)
+{
+    Object *root = qatomic_load_acquire(&object_root);
+
+    if (root) {
+        return root;
+    }
+
+    pthread_mutex_lock(&object_paths_lock);
+    if (!object_root) {
+        object_paths = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                             g_free, NULL);
+        object_path_names = g_hash_table_new(NULL, NULL);
+        root = object_new(TYPE_CONTAINER);
+        object_path_index_add(root, g_strdup("/"));
+        qatomic_store_release(&object_root, root);
+    }
+    root = object_root;
+    pthread_mutex_unlock(&object_paths_lock);
+
+    return root;
+}
+
+Object *container_get(Object *root, const char *path)
+{
+    Object *obj = root, *child;
+    const char *end;
+    char *name;
+
+    while (*path) {
+        end = strchr(path, '/');
+        if (!end) {
+            end = path + strlen(path);
+        }
+
+        if (end > path) {
+            name = g_strdup_printf("%.*s", (int)(end - path), path);
+            child = object_resolve_path_component(obj, name);
+            if (!child) {
+                child = object_new(TYPE_CONTAINER);
+                object_property_add_child(obj, name, child, &error_abort);
+                object_unref(child);
+            }
+            g_free(name);
+            obj = child;
+        }
+
+        path = *end ? end + 1 : end;
+    }
+
+    return obj;
+}
+
+char *object_get_canonical_path(Object *obj)
+{
+    char *path;
+
+    pthread_mutex_lock(&object_paths_lock);
+    path = object_path_names ? g_hash_table_lookup(object_path_names, obj)
+                             : NULL;
+    path = g_strdup(path);
+    pthread_mutex_unlock(&object_paths_lock);
+
+    return path;
+}
+
+Object *object_resolve_path(const char *path)
+{
+    Object *obj;
+
+    object_get_root();
+
+    pthread_mutex_lock(&object_paths_lock);
+    obj = g_hash_table_lookup(object_paths, path);
+    pthread_mutex_unlock(&object_paths_lock);
+
+    return obj;
+}
+
+Object *object_resolve_path_component(Object *parent, const char *part)
+{
+    ObjectProperty *prop = g_hash_table_lookup(parent->properties, part);
+
+    return prop ? prop->target : NULL;
+}
+
+Object *object_property_get_child(Object *obj, const char *name)
+{
+    ObjectProperty *prop = g_hash_table_lookup(obj->properties, name);
+
+    return prop && prop->kind == OBJECT_PROPERTY_CHILD ? prop->target : NULL;
+}
+
+int object_property_foreach(Object *obj,
+                            int (*fn)(const char *name, Object *target,
+                                      bool child, void *opaque),
+                            void *opaque)
+{
+    GHashTableIter iter;
+    ObjectProperty *prop;
+    int ret = 0;
+
+    g_hash_table_iter_init(&iter, obj->properties);
+    while (!ret && g_hash_table_iter_next(&iter, NULL, (gpointer *)&prop)) {
+        ret = fn(prop->name, prop->target, prop->kind == OBJECT_PROPERTY_CHILD,
+                 opaque);
+    }
+
+    return ret;
+}
+
+/*
+ * Weak references.  The tables map every object with weak references to
+ * the list of them, and Object.has_weak_refs spares objects without weak
+ * references the lookup on finalization.  They are sharded by object
+ * address, so that weak references to different objects rarely share a
+ * lock, and reading a cleared weak reference takes none.  A weak
+ * reference can only be pointed to or away from an object with the lock
+ * of its shard held, and finalization takes it too, so holding it keeps
+ * the object in ObjectWeakRef.obj allocated.
+ */
+#define WEAK_REF_SHARDS 64
+
+typedef struct WeakRefShard {
+    pthread_rwlock_t lock;
+    GHashTable *refs;
+} WeakRefShard;
+
+static WeakRefShard weak_ref_shards[WEAK_REF_SHARDS];
+static pthread_once_t weak_ref_shards_once = PTHREAD_ONCE_INIT;
+
+static void weak_ref_shards_init(void)
+{
+    int i;
+
+    for (i = 0; i < WEAK_REF_SHARDS; i++) {
+        pthread_rwlock_init(&weak_ref_shards[i].lock, NULL);
+        weak_ref_shards[i].refs = g_hash_table_new(NULL, NULL);
+    }
+}
+
+static WeakRefShard *weak_ref_shard(Object *obj)
+{
+    gsize addr = GPOINTER_TO_SIZE(obj);
+
+    return &weak_ref_shards[((addr >> 6) ^ (addr >> 12)) % WEAK_REF_SHARDS];
+}
+
+/* Locks the shards of @a and @b, either of which may be %NULL. */
+static void weak_ref_shards_lock(WeakRefShard *a, WeakRefShard *b)
+{
+    if (a > b) {
+        WeakRefShard *tmp = a;
+
+        a = b;
+        b = tmp;
+    }
+    if (a) {
+        pthread_rwlock_wrlock(&a->lock);
+    }
+    if (b && b != a) {
+        pthread_rwlock_wrlock(&b->lock);
+    }
+}
+
+static void weak_ref_shards_unlock(WeakRefShard *a, WeakRefShard *b)
+{
+    if (a) {
+        pthread_rwlock_unlock(&a->lock);
+    }
+    if (b && b != a) {
+        pthread_rwlock_unlock(&b->lock);
+    }
+}
+
+static void object_weak_ref_unlink(ObjectWeakRef *wr, Object *obj,
+                                   WeakRefShard *shard)
+{
+    GSList *list;
+
+    list = g_slist_remove(g_hash_table_lookup(shard->refs, obj), wr);
+    if (list) {
+        g_hash_table_insert(shard->refs, obj, list);
+    } else {
+        g_hash_table_remove(shard->refs, obj);
+        qatomic_set(&obj->has_weak_refs, false);
+    }
+}
+
+void object_weak_ref_set(ObjectWeakRef *wr, Object *obj)
+{
+    WeakRefShard *old_shard, *new_shard;
+    Object *old;
+
+    pthread_once(&weak_ref_shards_once, weak_ref_shards_init);
+    new_shard = obj ? weak_ref_shard(obj) : NULL;
+
+    /* Retry if @wr was retargeted before the locks were taken.  No lock
+     * covers a cleared weak reference, so it is claimed atomically.
+     */
+    for (;;) {
+        old = qatomic_read(&wr->obj);
+        if (old == obj) {
+            return;
+        }
+        old_shard = old ? weak_ref_shard(old) : NULL;
+        weak_ref_shards_lock(old_shard, new_shard);
+        if (old ? qatomic_read(&wr->obj) == old
+                : qatomic_cmpxchg(&wr->obj, NULL, obj) == NULL) {
+            break;
+        }
+        weak_ref_shards_unlock(old_shard, new_shard);
+    }
+
+    if (old) {
+        object_weak_ref_unlink(wr, old, old_shard);
+    }
+    if (obj) {
+        g_assert_cmpint(qatomic_read(&obj->ref), >, 0);
+        g_hash_table_insert(new_shard->refs, obj,
+                            g_slist_prepend(g_hash_table_lookup(new_shard->refs,
+                                                                obj),
+                                            wr));
+        qatomic_set(&obj->has_weak_refs, true);
+    }
+    qatomic_set(&wr->obj, obj);
+    weak_ref_shards_unlock(old_shard, new_shard);
+}
+
+void object_weak_ref_init(ObjectWeakRef *wr, Object *obj)
+{
+    wr->obj = NULL;
+    object_weak_ref_set(wr, obj);
+}
+
+void object_weak_ref_clear(ObjectWeakRef *wr)
+{
+    object_weak_ref_set(wr, NULL);
+}
+
+Object *object_weak_ref_get(ObjectWeakRef *wr)
+{
+    WeakRefShard *shard;
+    Object *obj;
+    guint32 ref;
+
+    for (;;) {
+        obj = qatomic_read(&wr->obj);
+        if (!obj) {
+            return NULL;
+        }
+        shard = weak_ref_shard(obj);
+        pthread_rwlock_rdlock(&shard->lock);
+        if (qatomic_read(&wr->obj) == obj) {
+            break;
+        }
+        pthread_rwlock_unlock(&shard->lock);
+    }
+
+    /* The object cannot be freed while the lock is held, but it may
+     * already have lost its last reference; never resurrect it.
+     */
+    ref = qatomic_read(&obj->ref);
+    while (ref) {
+        guint32 old = qatomic_cmpxchg(&obj->ref, ref, ref + 1);
+
+        if (old == ref) {
+            break;
+        }
+        ref = old;
+    }
+    pthread_rwlock_unlock(&shard->lock);
+
+    return ref ? obj : NULL;
+}
+
+static void object_weak_refs_clear(Object *obj)
+{
+    WeakRefShard *shard = weak_ref_shard(obj);
+    GSList *list, *l;
+
+    pthread_rwlock_wrlock(&shard->lock);
+    list = g_hash_table_lookup(shard->refs, obj);
+    for (l = list; l; l = l->next) {
+        ObjectWeakRef *wr = l->data;
+
+        qatomic_set(&wr->obj, NULL);
+    }
+    g_slist_free(list);
+    g_hash_table_remove(shard->refs, obj);
+    qatomic_set(&obj->has_weak_refs, false);
+    pthread_rwlock_unlock(&shard->lock);
+}
+
+static void object_finalize(void *data)
+{
+    Object *obj = data;
+    TypeImpl *ti = obj->class->type;
+    guint64 finalize_start;
+
+    trace_object_finalize(ti->hdr.name, obj);
+    if (qatomic_read(&obj->has_weak_refs)) {
+        object_weak_refs_clear(obj);
+    }
+    object_property_del_all(obj);
+    finalize_start = stats_clock_ns();
+    object_deinit(obj, ti);
+    g_hash_table_unref(obj->properties);
+    type_stats_finalized(ti, finalize_start);
+
+    g_assert_cmpint(obj->ref, ==, 0);
+    if (obj->free) {
+        obj->free(obj);
+    }
+}
+
+static Object *object_new_with_type(Type type)
+{
+    Object *obj;
+
+    g_assert(type != NULL);
+    type_initialize(type);
+
+    obj = g_malloc(type->instance_size);
+    object_initialize_with_type(obj, type->instance_size, type);
+    obj->free = g_free;
+
+    return obj;
+}
+
+Object *object_new(const char *typename)
+{
+    TypeImpl *ti = type_get_by_name(typename);
+
+    return object_new_with_type(ti);
+}
+
+Object *object_clone(Object *src)
+{
+    TypeImpl *type = src->class->type;
+    guint64 init_start;
+    Object *obj;
+
+    obj = g_malloc(type->instance_size);
+    init_start = stats_clock_ns();
+    object_copy_instance(obj, src, type);
+    obj->free = g_free;
+    type_stats_created(type, init_start);
+    trace_object_init(type->hdr.name, obj);
+
+    return obj;
+}
+
+Object *object_dynamic_cast(Object *obj, const char *typename)
+{
+    if (obj && object_class_dynamic_cast(object_get_class(obj), typename)) {
+        return obj;
+    }
+
+    if (obj) {
+        trace_object_cast_fail(object_get_typename(obj), obj, typename);
+    }
+    return NULL;
+}
+
+/* Returns what @class was last cast to as @target, or %NULL if the
+ * cast is not in its cache.
+ */
+static ObjectClass *type_cast_cache_lookup(ObjectClass *class,
+                                           TypeImpl *target)
+{
+    TypeCastCache *cache = class->type->cast_cache;
+    ObjectClass *ret = NULL;
+    unsigned seq;
+    int i;
+
+    seq = qatomic_load_acquire(&cache->seq);
+    if (seq & 1) {
+        return NULL;
+    }
+    for (i = 0; i < TYPE_CAST_CACHE; i++) {
+        if (qatomic_read(&cache->target[i]) == target) {
+            ret = qatomic_read(&cache->ret[i]);
+            break;
+        }
+    }
+    smp_mb_acquire();
+
+    return qatomic_read(&cache->seq) == seq ? ret : NULL;
+}
+
+/* Remembers a successful cast.  A thread that finds another one updating
+ * the cache just leaves it alone.
+ */
+static void type_cast_cache_insert(ObjectClass *class, TypeImpl *target,
+                                   ObjectClass *ret)
+{
+    TypeCastCache *cache = class->type->cast_cache;
+    unsigned seq = qatomic_read(&cache->seq);
+    int i;
+
+    if ((seq & 1) || qatomic_cmpxchg(&cache->seq, seq, seq + 1) != seq) {
+        return;
+    }
+    smp_mb();
+    for (i = 1; i < TYPE_CAST_CACHE; i++) {
+        qatomic_set(&cache->target[i - 1], qatomic_read(&cache->target[i]));
+        qatomic_set(&cache->ret[i - 1], qatomic_read(&cache->ret[i]));
+    }
+    qatomic_set(&cache->target[i - 1], target);
+    qatomic_set(&cache->ret[i - 1], ret);
+    qatomic_store_release(&cache->seq, seq + 2);
+}
+
+/* object_class_dynamic_cast(), through the cast cache of @class. */
+static ObjectClass *object_class_dynamic_cast_cached(ObjectClass *class,
+                                                     const char *typename)
+{
+    TypeImpl *target;
     ObjectClass *ret;
 
-    if (!class || !class->interfaces) {
+    if (class->type->hdr.name == typename) {
         return class;
     }
 
-    ret = object_class_dynamic_cast(class, typename);
-    if (!ret && class) {
-        fprintf(stderr, "%s:%d:%s: Object %p is not an instance of type %s\n",
-                file, line, func, class, typename);
-        abort();
+    target = type_get_by_name(typename);
+    if (!target) {
+        return NULL;
+    }
+
+    ret = type_cast_cache_lookup(class, target);
+    if (!ret) {
+        ret = object_class_dynamic_cast(class, typename);
+        if (ret) {
+            type_cast_cache_insert(class, target, ret);
+        }
     }
 
     return ret;
 }
 
-const char *object_get_typename(const Object *obj)
+Object *object_dynamic_cast_assert(Object *obj, const char *typename,
+                                   const char *file, int line, const char *func)
 {
-    return obj->class->type->name;
+#ifdef CONFIG_QOM_CAST_PROFILE
+    guint64 start = cast_profile_clock();
+    bool ok = obj && object_class_dynamic_cast(obj->class, typename);
+
+    cast_profile_record(file, line, func,
+                        obj ? object_get_typename(obj) : NULL, typename,
+                        ok, cast_profile_clock() - start);
+#endif
+
+    g_assert(obj != NULL);
+
+    if (!object_class_dynamic_cast_cached(obj->class, typename)) {
+        trace_object_cast_fail(object_get_typename(obj), obj, typename);
+        fprintf(stderr, "%s:%d:%s: Object %p is not an instance of type %s\n",
+                file, line, func, obj, typename);
+        abort();
+    }
+
+    return obj;
 }
 
-ObjectClass *object_get_class(Object *obj)
+ObjectClass *object_class_dynamic_cast(ObjectClass *class,
+                                       const char *typename)
 {
-    return obj->class;
+    ObjectClass *ret = NULL;
+    TypeImpl *target_type;
+    TypeImpl *type;
+
+    if (!class) {
+        return NULL;
+    }
+
+    /* A simple fast path that can trigger a lot for leaf classes.  */
+    type = class->type;
+    if (type->hdr.name == typename) {
+        return class;
+    }
+
+    target_type = type_get_by_name(typename);
+    if (!target_type) {
+        /* target class type unknown, so fail the cast */
+        return NULL;
+    }
+
+    /* Nothing derives from a final type, so only the type itself matches. */
+    if (target_type->hdr.final) {
+        return type == target_type ? class : NULL;
+    }
+
+    /* If the type_interface is the ancestor of the target_type to be cast,
+     * then we iterate through the interfaces to find the target class.
+     * Otherwise, we just check whether the target_type is the ancestor of 
+     * the type.
+     */
+    if (class->interfaces &&
+            type_is_ancestor(target_type, type_interface)) {
+        int found = 0;
+        GSList *i;
+
+        for (i = class->interfaces; i; i = i->next) {
+            ObjectClass *target_class = i->data;
+
+            if (type_is_ancestor(target_class->type, target_type)) {
+                ret = target_class;
+                found++;
+            }
+         }
+
+        /* The match was ambiguous, don't allow a cast */
+        if (found > 1) {
+            ret = NULL;
+        }
+    } else if (type_is_ancestor(type, target_type)) {
+        ret = class;
+    }
+
+    return ret;
 }
 
-bool object_class_is_abstract(ObjectClass *klass)
+ObjectClass *object_class_dynamic_cast_assert(ObjectClass *class,
+                                              const char *typename,
+                                              const char *file,
+                                              int line,
+                                              const char *func)
 {
-    return klass->type->abstract;
+    ObjectClass *ret;
+
+#ifdef CONFIG_QOM_CAST_PROFILE
+    guint64 start = cast_profile_clock();
+    bool ok = object_class_dynamic_cast(class, typename) != NULL;
+
+    cast_profile_record(file, line, func, class ? class->type->hdr.name : NULL,
+                        typename, ok, cast_profile_clock() - start);
+#endif
+
+    if (!class) {
+        return NULL;
+    }
+
+    ret = object_class_dynamic_cast_cached(class, typename);
+    if (!ret) {
+        trace_object_cast_fail(class->type->hdr.name, class, typename);
+        fprintf(stderr, "%s:%d:%s: Object %p is not an instance of type %s\n",
+                file, line, func, class, typename);
+        abort();
+    }
+
+    return ret;
 }
 
-const char *object_class_get_name(ObjectClass *klass)
+ObjectClass *object_class_cache_miss(ObjectClass **cache, ObjectClass *klass,
+                                     const char *typename, const char *file,
+                                     int line, const char *func)
 {
-    return klass->type->name;
+    ObjectClass *ret;
+
+    ret = object_class_dynamic_cast_assert(klass, typename, file, line, func);
+    /* An interface cast returns another class, which cannot be cached. */
+    if (ret == klass) {
+        qatomic_set(cache, klass);
+    }
+
+    return ret;
 }
 
 ObjectClass *object_class_by_name(const char *typename)
@@ -602,47 +1908,122 @@ ObjectClass *object_class_get_parent(ObjectClass *class)
     return type->class;
 }
 
-typedef struct OCFData
+/*
+ * For every type enumerated with object_class_foreach(), a snapshot of the
+ * registered types that implement it is cached; the %NULL key holds all
+ * types.  Snapshots are built from the TypeImpls alone, so that classes
+ * are only initialized for the types that are actually passed to the
+ * callback, and rebuilt once a type registered since then bumps the
+ * generation.  The index lives on the heap rather than in the type arena,
+ * so it still works once the registry is frozen.
+ */
+static pthread_mutex_t type_implementors_lock = PTHREAD_MUTEX_INITIALIZER;
+static GHashTable *type_implementors;
+
+/* Whether object_class_dynamic_cast() to @target succeeds for the class of
+ * @type, without initializing the class.
+ */
+static bool type_implements(TypeImpl *type, TypeImpl *target)
 {
-    void (*fn)(ObjectClass *klass, void *opaque);
-    const char *implements_type;
-    bool include_abstract;
-    void *opaque;
-} OCFData;
+    TypeImpl *t;
+    int i;
+
+    for (t = type; t; t = type_get_parent(t)) {
+        if (t == target) {
+            return true;
+        }
+
+        for (i = 0; i < t->num_interfaces; i++) {
+            TypeImpl *iface = type_get_by_name(t->interfaces[i].typename);
+
+            if (iface && type_is_ancestor(iface, target)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
 
-static void object_class_foreach_tramp(gpointer key, gpointer value,
-                                       gpointer opaque)
+/* Like the abstract flag type_initialize() computes. */
+static bool type_is_abstract(TypeImpl *ti)
 {
-    OCFData *data = opaque;
-    TypeImpl *type = value;
-    ObjectClass *k;
+    return ti->hdr.abstract || type_object_get_size(ti) == 0;
+}
 
-    type_initialize(type);
-    k = type->class;
+static TypeSnapshot *type_get_implementors(TypeImpl *target)
+{
+    TypeSnapshot *all, *snap, *cached;
+    int i;
 
-    if (!data->include_abstract && type->abstract) {
-        return;
+    pthread_mutex_lock(&type_implementors_lock);
+    if (!type_implementors) {
+        type_implementors = g_hash_table_new_full(
+            NULL, NULL, NULL, (GDestroyNotify)type_snapshot_unref);
     }
 
-    if (data->implements_type && 
-        !object_class_dynamic_cast(k, data->implements_type)) {
-        return;
+    snap = g_hash_table_lookup(type_implementors, target);
+    if (snap && snap->generation == qatomic_read(&type_registry_generation)) {
+        qatomic_inc(&snap->ref);
+        pthread_mutex_unlock(&type_implementors_lock);
+        return snap;
+    }
+    pthread_mutex_unlock(&type_implementors_lock);
+
+    all = type_table_snapshot();
+    if (target) {
+        snap = type_snapshot_new(all->num_types);
+        snap->generation = all->generation;
+        for (i = 0; i < all->num_types; i++) {
+            if (type_implements(all->types[i], target)) {
+                snap->types[snap->num_types++] = all->types[i];
+            }
+        }
+        type_snapshot_unref(all);
+    } else {
+        snap = all;
+    }
+
+    /* Another thread may have cached a newer snapshot meanwhile. */
+    pthread_mutex_lock(&type_implementors_lock);
+    cached = g_hash_table_lookup(type_implementors, target);
+    if (!cached || (gint)(snap->generation - cached->generation) > 0) {
+        qatomic_inc(&snap->ref);
+        g_hash_table_replace(type_implementors, target, snap);
     }
+    pthread_mutex_unlock(&type_implementors_lock);
 
-    data->fn(k, data->opaque);
+    return snap;
 }
 
 void object_class_foreach(void (*fn)(ObjectClass *klass, void *opaque),
                           const char *implements_type, bool include_abstract,
                           void *opaque)
 {
-    OCFData data = { fn, implements_type, include_abstract, opaque };
+    TypeSnapshot *snap;
+    TypeImpl *target = NULL;
+    int i;
 
-    enumerating_types = true;
-    g_hash_table_foreach(type_table_get(), object_class_foreach_tramp, &data);
-    enumerating_types = false;
-}
+    if (implements_type) {
+        target = type_get_by_name(implements_type);
+        if (!target) {
+            return;
+        }
+    }
+
+    snap = type_get_implementors(target);
+    for (i = 0; i < snap->num_types; i++) {
+        TypeImpl *ti = snap->types[i];
+
+        if (!include_abstract && type_is_abstract(ti)) {
+            continue;
+        }
 
+        type_initialize(ti);
+        fn(ti->class, opaque);
+    }
+    type_snapshot_unref(snap);
+}
 
 static void object_class_get_list_tramp(ObjectClass *klass, void *opaque)
 {
@@ -667,7 +2048,144 @@ void object_ref(Object *obj)
         return;
     }
 
-    obj->ref--;
+    qatomic_inc(&obj->ref);
+}
+
+/*
+ * Deferred finalization.  Dead objects are pushed on a lock-free stack
+ * linked through Object.deferred_next.  The reclaimer takes the whole stack
+ * with a single exchange rather than popping objects one by one, so the
+ * stack cannot suffer from ABA.
+ */
+static bool finalize_deferred;
+static Object *deferred_objects;
+
+static pthread_mutex_t reclaimer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reclaimer_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t reclaimer_thread;
+static bool reclaimer_running;
+static bool reclaimer_stopping;
+
+static void object_defer_finalize(Object *obj)
+{
+    Object *head = qatomic_read(&deferred_objects), *old;
+
+    do {
+        old = head;
+        obj->deferred_next = old;
+        head = qatomic_cmpxchg(&deferred_objects, old, obj);
+    } while (head != old);
+
+    /* The reclaimer rechecks the queue under the lock before sleeping, so
+     * it only needs waking when the queue becomes non-empty.
+     */
+    if (!old && qatomic_read(&reclaimer_running)) {
+        pthread_mutex_lock(&reclaimer_lock);
+        pthread_cond_signal(&reclaimer_cond);
+        pthread_mutex_unlock(&reclaimer_lock);
+    }
+}
+
+static void object_finalize_chain(gpointer key, gpointer value,
+                                  gpointer opaque)
+{
+    Object *obj = value, *next;
+    int *count = opaque;
+
+    for (; obj; obj = next) {
+        next = obj->deferred_next;
+        object_finalize(obj);
+        (*count)++;
+    }
+}
+
+int object_reclaim(void)
+{
+    GHashTable *by_type;
+    Object *obj, *next;
+    int count = 0;
+
+    by_type = g_hash_table_new(NULL, NULL);
+    while ((obj = qatomic_xchg(&deferred_objects, NULL))) {
+        /* Relinking the stack into one chain per type also puts each
+         * chain back in the order the objects died.
+         */
+        for (; obj; obj = next) {
+            TypeImpl *ti = obj->class->type;
+
+            next = obj->deferred_next;
+            obj->deferred_next = g_hash_table_lookup(by_type, ti);
+            g_hash_table_insert(by_type, ti, obj);
+        }
+
+        g_hash_table_foreach(by_type, object_finalize_chain, &count);
+        g_hash_table_remove_all(by_type);
+    }
+    g_hash_table_destroy(by_type);
+
+    return count;
+}
+
+void object_set_deferred_finalize(bool enable)
+{
+    qatomic_set(&finalize_deferred, enable);
+    if (!enable) {
+        object_reclaim();
+    }
+}
+
+static void *object_reclaimer_run(void *opaque)
+{
+    pthread_mutex_lock(&reclaimer_lock);
+    while (!reclaimer_stopping) {
+        if (!qatomic_read(&deferred_objects)) {
+            pthread_cond_wait(&reclaimer_cond, &reclaimer_lock);
+            continue;
+        }
+
+        pthread_mutex_unlock(&reclaimer_lock);
+        object_reclaim();
+        pthread_mutex_lock(&reclaimer_lock);
+    }
+    pthread_mutex_unlock(&reclaimer_lock);
+
+    return NULL;
+}
+
+bool object_start_reclaimer(Error **errp)
+{
+    int ret;
+
+    if (reclaimer_running) {
+        return true;
+    }
+
+    reclaimer_stopping = false;
+    ret = pthread_create(&reclaimer_thread, NULL, object_reclaimer_run, NULL);
+    if (ret != 0) {
+        error_setg(errp, "cannot create the reclaimer thread: %s",
+                   strerror(ret));
+        return false;
+    }
+    qatomic_set(&reclaimer_running, true);
+
+    return true;
+}
+
+void object_stop_reclaimer(void)
+{
+    if (!reclaimer_running) {
+        return;
+    }
+
+    pthread_mutex_lock(&reclaimer_lock);
+    reclaimer_stopping = true;
+    pthread_cond_signal(&reclaimer_cond);
+    pthread_mutex_unlock(&reclaimer_lock);
+    pthread_join(reclaimer_thread, NULL);
+    qatomic_set(&reclaimer_running, false);
+
+    object_reclaim();
 }
 
 void object_unref(Object *obj)
@@ -675,13 +2193,108 @@ void object_unref(Object *obj)
     if (!obj) {
         return;
     }
-    g_assert_cmpint(obj->ref, >, 0);
+    g_assert_cmpint(qatomic_read(&obj->ref), >, 0);
 
     /* parent always holds a reference to its children */
-    int ref = obj->ref--;
-    if (ref == 1) {
-        object_finalize(obj);
+    if (qatomic_fetch_dec(&obj->ref) == 1) {
+        if (qatomic_read(&finalize_deferred)) {
+            object_defer_finalize(obj);
+        } else {
+            object_finalize(obj);
+        }
+    }
+}
+
+bool object_type_get_stats(const char *typename, ObjectTypeStats *stats)
+{
+    TypeImpl *type = type_get_by_name(typename);
+
+    if (!type) {
+        return false;
+    }
+
+    stats->name = type->hdr.name;
+    stats->created = qatomic_read(&type->stats->created);
+    stats->alive = qatomic_read(&type->stats->alive);
+    stats->peak = qatomic_read(&type->stats->peak);
+    stats->bytes = qatomic_read(&type->stats->bytes);
+    stats->init_ns = qatomic_read(&type->stats->init_ns);
+    stats->finalize_ns = qatomic_read(&type->stats->finalize_ns);
+
+    return true;
+}
+
+typedef struct StatsForeachData
+{
+    void (*fn)(const ObjectTypeStats *stats, void *opaque);
+    void *opaque;
+} StatsForeachData;
+
+static void qom_stats_foreach_tramp(gpointer key, gpointer value,
+                                    gpointer opaque)
+{
+    StatsForeachData *data = opaque;
+    TypeImpl *type = value;
+    ObjectTypeStats stats;
+
+    if (qatomic_read(&type->stats->created) == 0) {
+        return;
+    }
+
+    object_type_get_stats(type->hdr.name, &stats);
+    data->fn(&stats, data->opaque);
+}
+
+void qom_stats_foreach(void (*fn)(const ObjectTypeStats *stats, void *opaque),
+                       void *opaque)
+{
+    StatsForeachData data = { fn, opaque };
+    TypeSnapshot *snap = type_table_snapshot();
+    int i;
+
+    for (i = 0; i < snap->num_types; i++) {
+        qom_stats_foreach_tramp(NULL, snap->types[i], &data);
+    }
+    type_snapshot_unref(snap);
+}
+
+static void qom_stats_collect(const ObjectTypeStats *stats, void *opaque)
+{
+    GSList **list = opaque;
+
+    *list = g_slist_prepend(*list, g_memdup(stats, sizeof(*stats)));
+}
+
+static gint qom_stats_compare_bytes(gconstpointer a, gconstpointer b)
+{
+    const ObjectTypeStats *sa = a, *sb = b;
+
+    if (sa->bytes != sb->bytes) {
+        return sa->bytes < sb->bytes ? 1 : -1;
+    }
+    return g_strcmp0(sa->name, sb->name);
+}
+
+void qom_stats_dump(FILE *out)
+{
+    GSList *list = NULL, *e;
+
+    qom_stats_foreach(qom_stats_collect, &list);
+    list = g_slist_sort(list, qom_stats_compare_bytes);
+
+    fprintf(out, "%-32s %12s %12s %12s %14s %14s %14s\n",
+            "type", "created", "alive", "peak", "bytes",
+            "init ns", "finalize ns");
+    for (e = list; e; e = e->next) {
+        ObjectTypeStats *stats = e->data;
+
+        fprintf(out, "%-32s %12llu %12llu %12llu %14llu %14llu %14llu\n",
+                stats->name, stats->created, stats->alive, stats->peak,
+                stats->bytes, stats->init_ns, stats->finalize_ns);
     }
+
+    g_slist_foreach(list, (GFunc)g_free, NULL);
+    g_slist_free(list);
 }
 
 static void register_types(void)
@@ -698,8 +2311,15 @@ static void register_types(void)
         .abstract = true,
     };
 
+    static TypeInfo container_info = {
+        .name = TYPE_CONTAINER,
+        .parent = TYPE_OBJECT,
+        .instance_size = sizeof(Object),
+    };
+
     type_interface = type_register_internal(&interface_info);
     type_register_internal(&object_info);
+    type_register_internal(&container_info);
 }
 
 void object_type_register(void){
@@ -13,6 +13,7 @@
 #define OBJECT_H
 
 #include <stdbool.h>
+#include <stdio.h>
 #include "glib.h"
 #include "error.h"
 
@@ -27,6 +28,9 @@ typedef struct TypeInfo TypeInfo;
 typedef struct InterfaceClass InterfaceClass;
 typedef struct InterfaceInfo InterfaceInfo;
 
+typedef struct ObjectWriter ObjectWriter;
+typedef struct ObjectReader ObjectReader;
+
 #define TYPE_OBJECT "object"
 
 /**
@@ -319,7 +323,85 @@ typedef void (ObjectUnparent)(Object *obj);
  */
 typedef void (ObjectFree)(void *obj);
 
-#define OBJECT_CLASS_CAST_CACHE 4
+/**
+ * ObjectSave:
+ * @obj: the object being serialized
+ * @w: the writer to put the fields into
+ *
+ * Called by object_serialize() to write the fields @obj's type adds to its
+ * parent; the fields of the parent types are saved by their own hooks.
+ * See qom/serialize.h.
+ */
+typedef void (ObjectSave)(Object *obj, ObjectWriter *w);
+
+/**
+ * ObjectLoad:
+ * @obj: the object being restored, already initialized
+ * @r: the reader holding what the #ObjectSave hook of the type wrote
+ * @version: the #TypeInfo.version of the type when the data was saved
+ * @errp: returns an error if the data cannot be restored
+ *
+ * Called by object_deserialize() to restore the fields saved by the
+ * type's #ObjectSave hook.  @version lets the hook convert data saved by
+ * older versions of the type.
+ *
+ * Returns: %true on success.
+ */
+typedef bool (ObjectLoad)(Object *obj, ObjectReader *r, int version,
+                          Error **errp);
+
+/**
+ * ObjectCopyKind:
+ * @OBJECT_COPY_END: Terminates a #TypeInfo.copy_fields array.
+ * @OBJECT_COPY_STRING: A `char *` owned by the instance; the clone gets
+ *   a g_strdup() copy.
+ * @OBJECT_COPY_REF: An `Object *` reference; the clone takes another
+ *   reference to the same object.
+ * @OBJECT_COPY_CLONE: An `Object *` owned by the instance; the clone
+ *   gets an object_clone() copy.
+ * @OBJECT_COPY_NULL: A pointer that must not be shared, such as a cache
+ *   or a back pointer; it is %NULL in the clone.
+ * @OBJECT_COPY_CHILD: An `Object *` pointing to a child of the instance;
+ *   the clone points to its own copy of the child.
+ *
+ * How object_clone() copies a pointer field of an instance.  All other
+ * bytes of the instance are copied as they are.
+ */
+typedef enum ObjectCopyKind {
+    OBJECT_COPY_END = 0,
+    OBJECT_COPY_STRING,
+    OBJECT_COPY_REF,
+    OBJECT_COPY_CLONE,
+    OBJECT_COPY_NULL,
+    OBJECT_COPY_CHILD,
+} ObjectCopyKind;
+
+/**
+ * ObjectCopyField:
+ * @kind: How to copy the field.
+ * @offset: Offset of the field in the instance struct.
+ *
+ * One entry of a #TypeInfo.copy_fields array, usually written with
+ * OBJECT_COPY_FIELD().
+ */
+typedef struct ObjectCopyField {
+    ObjectCopyKind kind;
+    glong offset;
+} ObjectCopyField;
+
+#define OBJECT_COPY_FIELD(kind, type, field) \
+    { (kind), G_STRUCT_OFFSET(type, field) }
+
+/**
+ * ObjectCopy:
+ * @dst: the clone, holding a copy of the bytes of @src with its
+ *   #TypeInfo.copy_fields already fixed up
+ * @src: the object being cloned
+ *
+ * Called by object_clone() for whatever the copy descriptor of a type
+ * cannot express.
+ */
+typedef void (ObjectCopy)(Object *dst, Object *src);
 
 /**
  * ObjectClass:
@@ -333,9 +415,6 @@ struct ObjectClass
     Type type;
     GSList *interfaces;
 
-    const char *object_cast_cache[OBJECT_CLASS_CAST_CACHE];
-    const char *class_cast_cache[OBJECT_CLASS_CAST_CACHE];
-
     ObjectUnparent *unparent;
 
     GHashTable *properties;
@@ -360,9 +439,24 @@ struct Object
     ObjectFree *free;
     GHashTable *properties;
     guint32 ref;
+    bool has_weak_refs;
     Object *parent;
+    const char *child_name;
+    Object *deferred_next;
 };
 
+/**
+ * ObjectWeakRef:
+ *
+ * A non-owning reference to an object, which reads as %NULL once the object
+ * is finalized.  Embed it in the structure that holds the reference and
+ * only access it through the object_weak_ref_*() functions.
+ */
+typedef struct ObjectWeakRef {
+    /*< private >*/
+    Object *obj;
+} ObjectWeakRef;
+
 /**
  * TypeInfo:
  * @name: The name of the type.
@@ -404,6 +498,30 @@ struct Object
  * @interfaces: The list of interfaces associated with this type.  This
  *   should point to a static array that's terminated with a zero filled
  *   element.
+ * @version: The version of the serialized state of this type, passed back
+ *   to @load.  Increase it whenever @save changes what it writes.
+ * @save: Writes the instance fields this type adds, see #ObjectSave.
+ * @load: Restores the fields written by @save, see #ObjectLoad.  Types
+ *   with a @save hook need a @load hook too.
+ * @copy_fields: The pointer fields this type adds to the instance and how
+ *   object_clone() copies them, terminated by an %OBJECT_COPY_END entry.
+ *   Everything else is copied byte by byte.
+ * @instance_copy: Called by object_clone() after the copy descriptors of
+ *   all types have been applied, root type first.
+ * @prototype: If this field is true, the instance_init chain of the type
+ *   runs only once, when the first object of the type is created, to
+ *   build a prototype instance.  Objects of the type are then initialized
+ *   by copying the prototype as object_clone() does, followed by
+ *   @instance_post_copy.  Only set it if the instance_init functions of
+ *   the type and all its ancestors always produce the same state.  If
+ *   they add child or link properties, the prototype is dropped and every
+ *   object runs instance_init as without this field.
+ * @instance_post_copy: Called, root type first, on objects initialized
+ *   from the prototype, for the per-object part of initialization.
+ * @final: If this field is true, no type may be derived from this type;
+ *   registering or initializing a subtype aborts.  Casts to a final type
+ *   are a single type comparison, and its methods are known exactly, so
+ *   calls can be devirtualized with OBJECT_CALL_LIKELY().
  */
 
 typedef enum TypeInitPhase
@@ -432,6 +550,18 @@ struct TypeInfo
     TypeInitPhase type_init_phase; 
 
     InterfaceInfo *interfaces;
+
+    bool final;
+
+    int version;
+    ObjectSave *save;
+    ObjectLoad *load;
+
+    const ObjectCopyField *copy_fields;
+    ObjectCopy *instance_copy;
+
+    bool prototype;
+    void (*instance_post_copy)(Object *obj);
 };
 
 /**
@@ -468,6 +598,25 @@ struct TypeInfo
      (get_class_by_name((name), __FILE__, __LINE__, __func__))
 
 
+/*
+ * QOM cast debugging.  With CONFIG_QOM_CAST_DEBUG, OBJECT_CHECK(),
+ * INTERFACE_CHECK() and OBJECT_CLASS_CHECK() verify every cast and abort
+ * on a mismatch; a per-class cache of recently checked types keeps
+ * repeated checks O(1).  Without it, OBJECT_CHECK() and INTERFACE_CHECK()
+ * are plain pointer casts and OBJECT_CLASS_CHECK() only looks up
+ * interface classes.  The cast profiler needs the checked calls too.
+ *
+ * The macros expand in the code that uses them, so it is the defines of
+ * each translation unit, not how libqom was built, that decide whether
+ * its casts are checked.  libqom checks every cast that reaches it,
+ * whatever its own settings.  Casts only reach the profiler of a
+ * CONFIG_QOM_CAST_PROFILE libqom from code that defines it as well, so
+ * build QOM users with the same CAST_PROFILE setting as the library.
+ */
+#if defined(CONFIG_QOM_CAST_DEBUG) || defined(CONFIG_QOM_CAST_PROFILE)
+#define OBJECT_CAST_CHECKED 1
+#endif
+
 /**
  * OBJECT_CHECK:
  * @type: The C type to use for the return value.
@@ -479,11 +628,16 @@ struct TypeInfo
  * this object type.
  *
  * If an invalid object is passed to this function, a run time assert will be
- * generated.
+ * generated if QOM cast debugging is enabled.
  */
+#ifdef OBJECT_CAST_CHECKED
 #define OBJECT_CHECK(type, obj, name) \
     ((type *)object_dynamic_cast_assert(OBJECT(obj), (name), \
                                         __FILE__, __LINE__, __func__))
+#else
+#define OBJECT_CHECK(type, obj, name) \
+    ((type *)(obj))
+#endif
 
 /**
  * OBJECT_CLASS_CHECK:
@@ -495,9 +649,15 @@ struct TypeInfo
  * typically wrapped by each type to perform type safe casts of a class to a
  * specific class type.
  */
+#ifdef OBJECT_CAST_CHECKED
 #define OBJECT_CLASS_CHECK(class_type, class, name) \
     ((class_type *)object_class_dynamic_cast_assert(OBJECT_CLASS(class), (name), \
                                                __FILE__, __LINE__, __func__))
+#else
+#define OBJECT_CLASS_CHECK(class_type, class, name) \
+    ((class_type *)object_class_check_inline(OBJECT_CLASS(class), (name), \
+                                             __FILE__, __LINE__, __func__))
+#endif
 
 /**
  * OBJECT_GET_CLASS:
@@ -555,9 +715,14 @@ struct InterfaceClass
  *
  * Returns: @obj casted to @interface if cast is valid, otherwise raise error.
  */
+#ifdef OBJECT_CAST_CHECKED
 #define INTERFACE_CHECK(interface, obj, name) \
     ((interface *)object_dynamic_cast_assert(OBJECT((obj)), (name), \
                                              __FILE__, __LINE__, __func__))
+#else
+#define INTERFACE_CHECK(interface, obj, name) \
+    ((interface *)(obj))
+#endif
 
 /**
  *  register the object type
@@ -590,6 +755,24 @@ Object *object_new(const char *typename);
 
 Object **objects_new(const char *typename, int num_object);
 
+/**
+ * object_clone:
+ * @src: The object to copy.
+ *
+ * Create a new object of the type of @src without running the
+ * instance_init chain: the instance is copied byte by byte, then the
+ * #TypeInfo.copy_fields of every type fix up the pointer fields, and the
+ * #TypeInfo.instance_copy hooks run.  Types whose instances own other
+ * resources must describe them there, otherwise the clone shares them.
+ * Before that, the children of @src are cloned recursively and added to
+ * the clone under the same names, and its link properties are added to
+ * the clone pointing to the same objects.
+ * The clone has a reference count of 1 and no parent.
+ *
+ * Returns: The clone.
+ */
+Object *object_clone(Object *src);
+
 /**
  * object_initialize:
  * @obj: A pointer to the memory to be used for the object.
@@ -626,22 +809,6 @@ Object *object_dynamic_cast(Object *obj, const char *typename);
 Object *object_dynamic_cast_assert(Object *obj, const char *typename,
                                    const char *file, int line, const char *func);
 
-/**
- * object_get_class:
- * @obj: A derivative of #Object
- *
- * Returns: The #ObjectClass of the type associated with @obj.
- */
-ObjectClass *object_get_class(Object *obj);
-
-/**
- * object_get_typename:
- * @obj: A derivative of #Object.
- *
- * Returns: The QOM typename of @obj.
- */
-const char *object_get_typename(const Object *obj);
-
 /**
  * type_register_static:
  * @info: The #TypeInfo of the new type.
@@ -674,6 +841,37 @@ Type type_register(const TypeInfo *info);
  */
 void type_register_static_array(const TypeInfo *infos, int nr_infos);
 
+/**
+ * type_initialize_all:
+ *
+ * Initialize the classes of all registered types now instead of on first
+ * use.  Classes are initialized in depth-first order of the type
+ * hierarchy, so every class is laid out right after its parent and next
+ * to its siblings in memory.  Call this once startup has registered its
+ * types.
+ */
+void type_initialize_all(void);
+
+/**
+ * type_registry_freeze:
+ *
+ * Finish the initialization of all classes with type_initialize_all()
+ * and write-protect the memory holding the types and classes.  After
+ * this, registering a type aborts and nothing writes to the protected
+ * pages anymore; per-type statistics live elsewhere and cast debugging
+ * stops filling the class cast caches.  A process that forks workers
+ * after startup can call this before forking, so that all workers share
+ * the type pages instead of copying them on first use.
+ */
+void type_registry_freeze(void);
+
+/**
+ * type_registry_is_frozen:
+ *
+ * Returns: %true once type_registry_freeze() has been called.
+ */
+bool type_registry_is_frozen(void);
+
 /**
  * void* get_class_by_name:
  * @typename: The QOM typename of the class to cast to.
@@ -707,6 +905,18 @@ ObjectClass *object_class_dynamic_cast_assert(ObjectClass *klass,
                                               const char *file, int line,
                                               const char *func);
 
+
+/**
+ * object_class_cache_miss:
+ *
+ * The slow path of OBJECT_GET_CLASS_CACHED(): checks @klass like
+ * OBJECT_CLASS_CHECK() does and remembers it in @cache if the cast
+ * leaves the class pointer unchanged.  Not meant to be called directly.
+ */
+ObjectClass *object_class_cache_miss(ObjectClass **cache, ObjectClass *klass,
+                                     const char *typename, const char *file,
+                                     int line, const char *func);
+
 /**
  * object_class_dynamic_cast:
  * @klass: The #ObjectClass to attempt to cast.
@@ -732,22 +942,6 @@ ObjectClass *object_class_dynamic_cast(ObjectClass *klass,
  */
 ObjectClass *object_class_get_parent(ObjectClass *klass);
 
-/**
- * object_class_get_name:
- * @klass: The class to obtain the QOM typename for.
- *
- * Returns: The QOM typename for @klass.
- */
-const char *object_class_get_name(ObjectClass *klass);
-
-/**
- * object_class_is_abstract:
- * @klass: The class to obtain the abstractness for.
- *
- * Returns: %true if @klass is abstract, %false otherwise.
- */
-bool object_class_is_abstract(ObjectClass *klass);
-
 /**
  * object_class_by_name:
  * @typename: The QOM typename to obtain the class for.
@@ -756,6 +950,17 @@ bool object_class_is_abstract(ObjectClass *klass);
  */
 ObjectClass *object_class_by_name(const char *typename);
 
+/**
+ * object_class_foreach:
+ * @fn: Function to call for each class.
+ * @implements_type: The type to filter for, including its derivatives.
+ * @include_abstract: Whether to include abstract classes.
+ * @opaque: An opaque pointer to pass to @fn.
+ *
+ * Call @fn for the classes of the types that were registered when the
+ * enumeration started.  @fn, or other threads, may register types
+ * meanwhile; those types are enumerated by later calls.
+ */
 void object_class_foreach(void (*fn)(ObjectClass *klass, void *opaque),
                           const char *implements_type, bool include_abstract,
                           void *opaque);
@@ -788,6 +993,272 @@ void object_ref(Object *obj);
  */
 void object_unref(Object *obj);
 
+/**
+ * object_weak_ref_init:
+ * @wr: The weak reference, uninitialized.
+ * @obj: The object to point to, or %NULL.  The caller must hold a
+ *   reference to it.
+ */
+void object_weak_ref_init(ObjectWeakRef *wr, Object *obj);
+
+/**
+ * object_weak_ref_set:
+ * @wr: The weak reference.
+ * @obj: The object to point to instead, or %NULL.  The caller must hold a
+ *   reference to it.
+ */
+void object_weak_ref_set(ObjectWeakRef *wr, Object *obj);
+
+/**
+ * object_weak_ref_get:
+ * @wr: The weak reference.
+ *
+ * Returns: A new reference to the object @wr points to, or %NULL if it was
+ * cleared or the object has lost its last reference.  Release it with
+ * object_unref().
+ */
+Object *object_weak_ref_get(ObjectWeakRef *wr);
+
+/**
+ * object_weak_ref_clear:
+ * @wr: The weak reference.
+ *
+ * Unregister @wr; call it before freeing the memory holding @wr.
+ */
+void object_weak_ref_clear(ObjectWeakRef *wr);
+
+/**
+ * object_set_deferred_finalize:
+ * @enable: Whether to defer finalization.
+ *
+ * While deferred finalization is enabled, object_unref() does not finalize
+ * an object whose last reference it drops.  It pushes the object on a
+ * lock-free queue instead, and the object is finalized later by
+ * object_reclaim() or by the reclaimer thread, on that thread.  Threads
+ * dropping references then never run instance_finalize hooks or free
+ * memory.  Disabling deferred finalization reclaims the queued objects.
+ */
+void object_set_deferred_finalize(bool enable);
+
+/**
+ * object_reclaim:
+ *
+ * Finalize the objects queued by deferred finalization, grouped by type.
+ * Objects whose last reference is dropped by those finalizers are
+ * reclaimed as well.  Call it at points where running finalizers is safe,
+ * e.g. once per iteration of a main loop.
+ *
+ * Returns: The number of objects finalized.
+ */
+int object_reclaim(void);
+
+/**
+ * object_start_reclaimer:
+ * @errp: Returns an error if the thread cannot be created.
+ *
+ * Start a thread that calls object_reclaim() whenever objects are queued
+ * for deferred finalization.  The instance_finalize hooks then run on that
+ * thread and must not rely on running on the thread that dropped the last
+ * reference.
+ *
+ * Returns: %true on success or if the thread is already running.
+ */
+bool object_start_reclaimer(Error **errp);
+
+/**
+ * object_stop_reclaimer:
+ *
+ * Stop the thread started by object_start_reclaimer() and reclaim the
+ * objects still queued.
+ */
+void object_stop_reclaimer(void);
+
+#define TYPE_CONTAINER "container"
+
+/*
+ * The composition tree.  Objects own their children through child
+ * properties and point to other objects through link properties.  Every
+ * object attached below the root container has a canonical path such as
+ * /machine/peripheral/foo; an index of those paths is updated when
+ * subtrees are attached and detached, so resolving a path is a single
+ * lookup.  Like QEMU's, the tree is not thread-safe: modify and resolve a
+ * subtree from one thread, or under a lock of the caller's.  Only the path
+ * index, which all subtrees share, has a lock of its own.
+ */
+
+/**
+ * object_property_add_child:
+ * @obj: The parent object.
+ * @name: The name of the child in @obj, which must not contain '/'.
+ * @child: The child object, which must not have a parent yet.
+ * @errp: Returns an error if @obj already has a property @name or @child
+ *   cannot become a child of @obj.
+ *
+ * Make @child a child of @obj.  @obj takes a reference to @child, which it
+ * drops when the child property is deleted, by object_unparent() or when
+ * @obj is finalized.
+ */
+void object_property_add_child(Object *obj, const char *name, Object *child,
+                               Error **errp);
+
+/**
+ * object_property_add_link:
+ * @obj: The object.
+ * @name: The name of the link in @obj, which must not contain '/'.
+ * @target: The object to link to.
+ * @errp: Returns an error if @obj already has a property @name.
+ *
+ * Add a property to @obj that holds a reference to @target, without making
+ * it a child of @obj.
+ */
+void object_property_add_link(Object *obj, const char *name, Object *target,
+                              Error **errp);
+
+/**
+ * object_property_del:
+ * @obj: The object.
+ * @name: The name of a child or link property of @obj.
+ *
+ * Delete the property and drop the reference it holds.  Deleting a child
+ * property removes the child from the composition tree.
+ */
+void object_property_del(Object *obj, const char *name);
+
+/**
+ * object_unparent:
+ * @obj: The object.
+ *
+ * Remove @obj from the composition tree, calling #ObjectClass.unparent
+ * first.  Does nothing if @obj has no parent.
+ */
+void object_unparent(Object *obj);
+
+/**
+ * object_get_root:
+ *
+ * Returns: The root container of the composition tree, created on first
+ * use.
+ */
+Object *object_get_root(void);
+
+/**
+ * container_get:
+ * @root: The object to start from.
+ * @path: A path relative to @root, e.g. "machine/peripheral".
+ *
+ * Returns: The object at @path below @root, creating the missing
+ * components as containers.
+ */
+Object *container_get(Object *root, const char *path);
+
+/**
+ * object_get_canonical_path:
+ * @obj: The object.
+ *
+ * Returns: The path of @obj from the root, to be freed with g_free(), or
+ * %NULL if @obj is not attached to the root.
+ */
+char *object_get_canonical_path(Object *obj);
+
+/**
+ * object_resolve_path:
+ * @path: An absolute canonical path, e.g. "/machine/peripheral/foo".
+ *
+ * Returns: The object at @path, or %NULL if there is none.  No reference
+ * is taken.
+ */
+Object *object_resolve_path(const char *path);
+
+/**
+ * object_resolve_path_component:
+ * @parent: The object.
+ * @part: The name of a child or link property of @parent.
+ *
+ * Returns: The object the property points to, or %NULL if @parent has no
+ * such property.  No reference is taken.
+ */
+Object *object_resolve_path_component(Object *parent, const char *part);
+
+/**
+ * object_property_foreach:
+ * @obj: The object.
+ * @fn: Function to call for each child and link property of @obj, with
+ *   the name of the property, the object it points to and whether it is a
+ *   child property.
+ * @opaque: An opaque pointer to pass to @fn.
+ *
+ * @fn must not add or delete properties of @obj.  The walk stops at the
+ * first non-zero value @fn returns.
+ *
+ * Returns: The last value returned by @fn, or 0 if @obj has no properties.
+ */
+int object_property_foreach(Object *obj,
+                            int (*fn)(const char *name, Object *target,
+                                      bool child, void *opaque),
+                            void *opaque);
+
+/**
+ * ObjectTypeStats:
+ * @name: The QOM typename.
+ * @created: Number of instances of exactly this type ever initialized.
+ * @alive: Number of instances that have not been finalized yet.
+ * @peak: Highest value @alive has reached.
+ * @bytes: Instance memory in use by the live instances.
+ * @init_ns: Cumulative time spent in the instance_init chain.
+ * @finalize_ns: Cumulative time spent in the instance_finalize chain.
+ *
+ * Per-type instance statistics.  The counters are always maintained;
+ * @init_ns and @finalize_ns only advance while timing is enabled with
+ * qom_stats_set_timing().
+ */
+typedef struct ObjectTypeStats {
+    const char *name;
+    guint64 created;
+    guint64 alive;
+    guint64 peak;
+    guint64 bytes;
+    guint64 init_ns;
+    guint64 finalize_ns;
+} ObjectTypeStats;
+
+/**
+ * object_type_get_stats:
+ * @typename: The QOM typename.
+ * @stats: Filled with a snapshot of the statistics of @typename.
+ *
+ * Returns: %false if @typename is not registered.
+ */
+bool object_type_get_stats(const char *typename, ObjectTypeStats *stats);
+
+/**
+ * qom_stats_foreach:
+ * @fn: Called with a snapshot of the statistics of every type that has
+ *   had at least one instance.
+ * @opaque: Passed to @fn.
+ *
+ * Use this to export the statistics in other formats.
+ */
+void qom_stats_foreach(void (*fn)(const ObjectTypeStats *stats, void *opaque),
+                       void *opaque);
+
+/**
+ * qom_stats_dump:
+ * @out: Stream to print to.
+ *
+ * Print the statistics of every type that has had at least one instance,
+ * largest memory users first.
+ */
+void qom_stats_dump(FILE *out);
+
+/**
+ * qom_stats_set_timing:
+ * @enable: Whether to time instance_init and instance_finalize.
+ *
+ * Timing reads the clock twice per object creation and destruction, so
+ * it is off by default.
+ */
+void qom_stats_set_timing(bool enable);
+
 /**
  * object_type_register:
  *
@@ -796,4 +1267,178 @@ void object_unref(Object *obj);
 
 void object_type_register(void);
 
+/*
+ * The accessors below are on the path of every virtual method call
+ * (FOO_GET_CLASS(obj)->method(obj)), so they are inline.  They only read
+ * the #TypeHeader every type starts with; the rest of the type layout is
+ * private to qom/ and may change without affecting users.
+ */
+
+/**
+ * TypeHeader:
+ *
+ * The public prefix of a #Type.  Read it through the accessors below.
+ */
+typedef struct TypeHeader {
+    /*< private >*/
+    const char *name;
+    bool abstract;
+    bool final;
+} TypeHeader;
+
+/* The header is the first member of a type, so a #Type converts to it. */
+static inline const TypeHeader *type_get_header(Type type)
+{
+    return (const TypeHeader *)type;
+}
+
+/**
+ * object_get_class:
+ * @obj: A derivative of #Object
+ *
+ * Returns: The #ObjectClass of the type associated with @obj.
+ */
+static inline ObjectClass *object_get_class(Object *obj)
+{
+    return obj->class;
+}
+
+/**
+ * object_get_typename:
+ * @obj: A derivative of #Object.
+ *
+ * Returns: The QOM typename of @obj.
+ */
+static inline const char *object_get_typename(const Object *obj)
+{
+    return type_get_header(obj->class->type)->name;
+}
+
+/**
+ * object_class_get_name:
+ * @klass: The class to obtain the QOM typename for.
+ *
+ * Returns: The QOM typename for @klass.
+ */
+static inline const char *object_class_get_name(ObjectClass *klass)
+{
+    return type_get_header(klass->type)->name;
+}
+
+/**
+ * object_class_is_abstract:
+ * @klass: The class to obtain the abstractness for.
+ *
+ * Returns: %true if @klass is abstract, %false otherwise.
+ */
+static inline bool object_class_is_abstract(ObjectClass *klass)
+{
+    return type_get_header(klass->type)->abstract;
+}
+
+/**
+ * object_class_is_final:
+ * @klass: The class to obtain the finality for.
+ *
+ * Returns: %true if no type may be derived from @klass.
+ */
+static inline bool object_class_is_final(ObjectClass *klass)
+{
+    return type_get_header(klass->type)->final;
+}
+
+#ifndef OBJECT_CAST_CHECKED
+/*
+ * Without cast debugging a class cast can only return something other
+ * than @class when @class implements interfaces, so only those classes
+ * take the out-of-line lookup.
+ */
+static inline ObjectClass *object_class_check_inline(ObjectClass *class,
+                                                     const char *typename,
+                                                     const char *file,
+                                                     int line,
+                                                     const char *func)
+{
+    if (!class || !class->interfaces) {
+        return class;
+    }
+    return object_class_dynamic_cast_assert(class, typename, file, line, func);
+}
+#endif
+
+/*
+ * Method dispatch.
+ *
+ * A virtual method is a function pointer at a fixed offset of the class
+ * struct, so FOO_GET_CLASS(obj)->method(obj) is two loads and an
+ * indirect call once the class check is out of the way.  The helpers
+ * below take the remaining overheads off hot call sites.
+ */
+
+/**
+ * OBJECT_METHOD_OFFSET:
+ * @class_type: The class struct declaring the method.
+ * @method: The name of the method member.
+ *
+ * Returns: The slot offset of @method, for object_class_get_method().
+ */
+#define OBJECT_METHOD_OFFSET(class_type, method) \
+    G_STRUCT_OFFSET(class_type, method)
+
+/**
+ * object_class_get_method:
+ * @klass: The class to look the method up in.
+ * @offset: A slot offset obtained with OBJECT_METHOD_OFFSET().
+ *
+ * Lets generic code resolve the slot of a method once and then dispatch
+ * through any class derived from the declaring one.
+ *
+ * Returns: The function pointer stored in the slot.
+ */
+static inline void *object_class_get_method(ObjectClass *klass, glong offset)
+{
+    return *(void **)((char *)klass + offset);
+}
+
+/**
+ * OBJECT_GET_CLASS_CACHED:
+ * @class_type: The C type to use for the return value.
+ * @obj: The object to obtain the class for.
+ * @name: The QOM typename of @class_type.
+ *
+ * Like OBJECT_GET_CLASS(), with a monomorphic inline cache: each call site
+ * remembers the last class it checked, and only a different class goes
+ * through the checked cast again.  This keeps call sites that always see
+ * the same type cheap when casts are checked, or when the class
+ * implements interfaces.  Hits are not recorded by the cast profiler.
+ */
+#define OBJECT_GET_CLASS_CACHED(class_type, obj, name) \
+    ({ \
+        static ObjectClass *_cache; \
+        ObjectClass *_klass = object_get_class(OBJECT(obj)); \
+        if (G_UNLIKELY(__atomic_load_n(&_cache, __ATOMIC_RELAXED) != \
+                       _klass)) { \
+            _klass = object_class_cache_miss(&_cache, _klass, (name), \
+                                             __FILE__, __LINE__, __func__); \
+        } \
+        (class_type *)_klass; \
+    })
+
+/**
+ * OBJECT_CALL_LIKELY:
+ * @fn: The method pointer, e.g. FOO_GET_CLASS(obj)->method.
+ * @likely_fn: The implementation expected at this call site.
+ * @...: The arguments of the call.
+ *
+ * Calls @fn, with a direct (and inlinable) call to @likely_fn when @fn is
+ * @likely_fn.  For a final type @likely_fn is exactly known, so the check
+ * always succeeds.
+ */
+#define OBJECT_CALL_LIKELY(fn, likely_fn, ...) \
+    ({ \
+        __typeof__(fn) _fn = (fn); \
+        G_LIKELY(_fn == (likely_fn)) ? (likely_fn)(__VA_ARGS__) \
+                                     : _fn(__VA_ARGS__); \
+    })
+
 #endif
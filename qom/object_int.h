@@ -0,0 +1,124 @@
+/*
+ * QEMU Object Model - private type layout
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+/*
+ * The layout of #TypeImpl is private to the object model; only code in
+ * qom/ includes this header, after object.h.
+ */
+
+#ifndef QOM_OBJECT_INT_H
+#define QOM_OBJECT_INT_H
+
+#include <pthread.h>
+
+#ifndef OBJECT_H
+#error "include object.h before object_int.h"
+#endif
+
+#define MAX_INTERFACES 32
+
+typedef struct InterfaceImpl InterfaceImpl;
+typedef struct TypeImpl TypeImpl;
+typedef struct TypePrototype TypePrototype;
+typedef struct TypeCastCache TypeCastCache;
+typedef void (ObjectInstanceHook)(Object *obj);
+
+struct InterfaceImpl
+{
+    const char *typename;
+};
+
+/* Written after the type pages may have been protected, so kept apart. */
+struct TypePrototype
+{
+    pthread_mutex_t lock;
+    Object *obj;
+    bool disabled;
+};
+
+#define TYPE_CAST_CACHE 4
+
+/* The last few successful casts of the class of a type, by target type.
+ * Also written after the type pages may have been protected.  @seq is
+ * odd while an entry is being replaced.
+ */
+struct TypeCastCache
+{
+    unsigned seq;
+    TypeImpl *target[TYPE_CAST_CACHE];
+    ObjectClass *ret[TYPE_CAST_CACHE];
+};
+
+struct TypeImpl
+{
+    /* First, so that a #Type also points to the #TypeHeader object.h
+     * exposes.
+     */
+    TypeHeader hdr;
+
+    size_t class_size;
+
+    size_t instance_size;
+
+    void (*class_init)(ObjectClass *klass, void *data);
+    void (*class_base_init)(ObjectClass *klass, void *data);
+    void (*class_finalize)(ObjectClass *klass, void *data);
+
+    void *class_data;
+
+    void (*instance_init)(Object *obj);
+    void (*instance_finalize)(Object *obj);
+
+    int version;
+    ObjectSave *save;
+    ObjectLoad *load;
+
+    const ObjectCopyField *copy_fields;
+    ObjectCopy *instance_copy;
+
+    TypePrototype *prototype;
+    void (*instance_post_copy)(Object *obj);
+
+    const char *parent;
+    TypeImpl *parent_type;
+
+    ObjectClass *class;
+    /* Only taken until the class is built, before the type pages may be
+     * protected.
+     */
+    pthread_mutex_t class_lock;
+    bool class_initializing;
+
+    int num_interfaces;
+    InterfaceImpl interfaces[MAX_INTERFACES];
+
+    /* The non-NULL instance hooks of the type and its ancestors, in the
+     * order they are called: init and post_copy from the root type down,
+     * finalize from the type up.  Built by type_initialize().
+     */
+    ObjectInstanceHook **init_hooks;
+    ObjectInstanceHook **post_copy_hooks;
+    ObjectInstanceHook **finalize_hooks;
+    int num_init_hooks;
+    int num_post_copy_hooks;
+    int num_finalize_hooks;
+
+    ObjectTypeStats *stats;
+    TypeCastCache *cast_cache;
+
+    /* Set when the type is bound to an entry of the loaded type image. */
+    int image_index;
+    const guint64 *ancestry;
+};
+
+/* Bounds the memory object_deserialize() allocates for a stream. */
+size_t type_get_max_instance_size(void);
+
+/* Returns the child property @name of @obj, or %NULL. */
+Object *object_property_get_child(Object *obj, const char *name);
+
+#endif
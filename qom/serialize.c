@@ -0,0 +1,675 @@
+/*
+ * QEMU Object Model binary serialization
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "serialize.h"
+#include "object_int.h"
+#include "atomic.h"
+
+#define OBJECT_STREAM_MAGIC "QOMSNAP"
+#define OBJECT_STREAM_VERSION 2
+
+#define OBJECT_STREAM_ALIGN 16
+#define OBJECT_STREAM_ROUND(n) \
+    (((n) + OBJECT_STREAM_ALIGN - 1) & ~(size_t)(OBJECT_STREAM_ALIGN - 1))
+
+#define OBJECT_STREAM_NULL_STR 0xffffffffu
+
+enum {
+    OBJECT_TAG_NULL,
+    OBJECT_TAG_NEW,
+    OBJECT_TAG_REF,
+};
+
+enum {
+    OBJECT_PROPERTY_TAG_CHILD,
+    OBJECT_PROPERTY_TAG_LINK,
+};
+
+typedef struct ObjectStreamHeader {
+    char magic[8];
+    guint32 version;
+    guint32 num_objects;
+    guint64 alloc_size;
+} ObjectStreamHeader;
+
+struct ObjectWriter {
+    char *buf;
+    size_t len;
+    size_t cap;
+    GHashTable *indices;
+    guint32 num_objects;
+    guint64 alloc_size;
+};
+
+/*
+ * Deserialized objects live in one block.  Each object is preceded by a
+ * slot pointing back to the block, which is freed when its last object
+ * is finalized.
+ */
+typedef struct ObjectBlock {
+    guint32 refs;
+} ObjectBlock;
+
+typedef struct ObjectBlockSlot {
+    ObjectBlock *block;
+} ObjectBlockSlot;
+
+#define OBJECT_BLOCK_HEADER OBJECT_STREAM_ROUND(sizeof(ObjectBlock))
+#define OBJECT_BLOCK_SLOT   OBJECT_STREAM_ROUND(sizeof(ObjectBlockSlot))
+
+typedef struct ObjectLoader {
+    ObjectBlock *block;
+    char *next;
+    char *end;
+    Object **objects;
+    guint32 num_objects;
+    guint32 loaded;
+    Error *err;
+} ObjectLoader;
+
+struct ObjectReader {
+    ObjectLoader *loader;
+    const char *pos;
+    const char *end;
+};
+
+static void object_writer_reserve(ObjectWriter *w, size_t len)
+{
+    if (w->len + len > w->cap) {
+        w->cap = MAX(w->cap * 2, w->len + len);
+        w->buf = g_realloc(w->buf, w->cap);
+    }
+}
+
+void object_writer_put_bytes(ObjectWriter *w, const void *data, size_t len)
+{
+    object_writer_reserve(w, len);
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+void object_writer_put_u32(ObjectWriter *w, guint32 value)
+{
+    object_writer_put_bytes(w, &value, sizeof(value));
+}
+
+void object_writer_put_u64(ObjectWriter *w, guint64 value)
+{
+    object_writer_put_bytes(w, &value, sizeof(value));
+}
+
+void object_writer_put_str(ObjectWriter *w, const char *str)
+{
+    size_t len;
+
+    if (!str) {
+        object_writer_put_u32(w, OBJECT_STREAM_NULL_STR);
+        return;
+    }
+
+    len = strlen(str);
+    object_writer_put_u32(w, len);
+    object_writer_put_bytes(w, str, len);
+}
+
+static int object_count_sections(TypeImpl *ti)
+{
+    int n = ti->save ? 1 : 0;
+
+    return ti->parent_type ? n + object_count_sections(ti->parent_type) : n;
+}
+
+static void object_save_sections(ObjectWriter *w, Object *obj, TypeImpl *ti)
+{
+    size_t len_offset;
+    guint32 len;
+
+    if (ti->parent_type) {
+        object_save_sections(w, obj, ti->parent_type);
+    }
+
+    if (!ti->save) {
+        return;
+    }
+
+    object_writer_put_str(w, ti->hdr.name);
+    object_writer_put_u32(w, ti->version);
+    len_offset = w->len;
+    object_writer_put_u32(w, 0);
+    ti->save(obj, w);
+
+    len = w->len - len_offset - sizeof(len);
+    memcpy(w->buf + len_offset, &len, sizeof(len));
+}
+
+typedef struct ObjectPropertyWalk {
+    ObjectWriter *w;
+    bool child;
+    guint32 count;
+} ObjectPropertyWalk;
+
+static int object_save_property(const char *name, Object *target, bool child,
+                                void *opaque)
+{
+    ObjectPropertyWalk *walk = opaque;
+
+    if (child == walk->child) {
+        object_writer_put_str(walk->w, name);
+        object_writer_put_u32(walk->w, child ? OBJECT_PROPERTY_TAG_CHILD
+                                             : OBJECT_PROPERTY_TAG_LINK);
+        object_writer_put_object(walk->w, target);
+        walk->count++;
+    }
+
+    return 0;
+}
+
+static void object_save_properties(ObjectWriter *w, Object *obj)
+{
+    ObjectPropertyWalk walk = { w };
+    size_t count_offset = w->len;
+
+    object_writer_put_u32(w, 0);
+
+    /* Children go first, so that a child is saved under its child
+     * property even when a link of the same object points to it.
+     */
+    walk.child = true;
+    object_property_foreach(obj, object_save_property, &walk);
+    walk.child = false;
+    object_property_foreach(obj, object_save_property, &walk);
+
+    memcpy(w->buf + count_offset, &walk.count, sizeof(walk.count));
+}
+
+static void object_save_record(ObjectWriter *w, Object *obj)
+{
+    TypeImpl *ti = obj->class->type;
+
+    g_hash_table_insert(w->indices, obj, GUINT_TO_POINTER(++w->num_objects));
+    w->alloc_size += OBJECT_BLOCK_SLOT + OBJECT_STREAM_ROUND(ti->instance_size);
+
+    object_writer_put_str(w, ti->hdr.name);
+    object_writer_put_u32(w, object_count_sections(ti));
+    object_save_sections(w, obj, ti);
+    object_save_properties(w, obj);
+}
+
+void object_writer_put_object(ObjectWriter *w, Object *obj)
+{
+    guint index;
+
+    if (!obj) {
+        object_writer_put_u32(w, OBJECT_TAG_NULL);
+        return;
+    }
+
+    index = GPOINTER_TO_UINT(g_hash_table_lookup(w->indices, obj));
+    if (index) {
+        object_writer_put_u32(w, OBJECT_TAG_REF);
+        object_writer_put_u32(w, index - 1);
+        return;
+    }
+
+    object_writer_put_u32(w, OBJECT_TAG_NEW);
+    object_save_record(w, obj);
+}
+
+void *object_serialize(Object *obj, size_t *size)
+{
+    ObjectWriter w = { 0 };
+    ObjectStreamHeader hdr = { OBJECT_STREAM_MAGIC, OBJECT_STREAM_VERSION };
+
+    g_assert(obj != NULL);
+
+    w.indices = g_hash_table_new(NULL, NULL);
+    object_writer_reserve(&w, 4096);
+    w.len = sizeof(hdr);
+
+    object_save_record(&w, obj);
+
+    hdr.num_objects = w.num_objects;
+    hdr.alloc_size = w.alloc_size;
+    memcpy(w.buf, &hdr, sizeof(hdr));
+    g_hash_table_destroy(w.indices);
+
+    *size = w.len;
+    return w.buf;
+}
+
+static const char *object_reader_take(ObjectReader *r, size_t len)
+{
+    const char *p = r->pos;
+
+    if ((size_t)(r->end - r->pos) < len) {
+        return NULL;
+    }
+
+    r->pos += len;
+    return p;
+}
+
+bool object_reader_get_bytes(ObjectReader *r, void *data, size_t len)
+{
+    const char *p = object_reader_take(r, len);
+
+    if (!p) {
+        return false;
+    }
+
+    memcpy(data, p, len);
+    return true;
+}
+
+bool object_reader_get_u32(ObjectReader *r, guint32 *value)
+{
+    return object_reader_get_bytes(r, value, sizeof(*value));
+}
+
+bool object_reader_get_u64(ObjectReader *r, guint64 *value)
+{
+    return object_reader_get_bytes(r, value, sizeof(*value));
+}
+
+bool object_reader_get_str(ObjectReader *r, char **str)
+{
+    const char *p;
+    guint32 len;
+    char *s;
+
+    if (!object_reader_get_u32(r, &len)) {
+        return false;
+    }
+
+    if (len == OBJECT_STREAM_NULL_STR) {
+        *str = NULL;
+        return true;
+    }
+
+    p = object_reader_take(r, len);
+    if (!p) {
+        return false;
+    }
+
+    s = g_malloc(len + 1);
+    memcpy(s, p, len);
+    s[len] = '\0';
+    *str = s;
+
+    return true;
+}
+
+static void object_block_unref(ObjectBlock *block)
+{
+    if (qatomic_fetch_dec(&block->refs) == 1) {
+        g_free(block);
+    }
+}
+
+static void object_block_free(void *obj)
+{
+    ObjectBlockSlot *slot = (ObjectBlockSlot *)((char *)obj - OBJECT_BLOCK_SLOT);
+
+    object_block_unref(slot->block);
+}
+
+static Object *object_alloc_in_block(ObjectLoader *l, size_t size)
+{
+    size_t need = OBJECT_BLOCK_SLOT + OBJECT_STREAM_ROUND(size);
+    ObjectBlockSlot *slot;
+
+    if ((size_t)(l->end - l->next) < need) {
+        return NULL;
+    }
+
+    slot = (ObjectBlockSlot *)l->next;
+    slot->block = l->block;
+    l->next += need;
+
+    return (Object *)((char *)slot + OBJECT_BLOCK_SLOT);
+}
+
+static TypeImpl *object_find_loader(TypeImpl *ti, const char *name)
+{
+    for (; ti; ti = ti->parent_type) {
+        if (!strcmp(ti->hdr.name, name)) {
+            return ti->load ? ti : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+static bool object_load_section(ObjectReader *r, Object *obj)
+{
+    ObjectLoader *l = r->loader;
+    ObjectReader section;
+    Error *local_err = NULL;
+    char *name = NULL;
+    guint32 version, len;
+    TypeImpl *ti;
+    bool ok = true;
+
+    if (!object_reader_get_str(r, &name) || !name ||
+        !object_reader_get_u32(r, &version) ||
+        !object_reader_get_u32(r, &len) ||
+        (size_t)(r->end - r->pos) < len) {
+        error_setg(&l->err, "truncated section header");
+        g_free(name);
+        return false;
+    }
+
+    section.loader = l;
+    section.pos = r->pos;
+    section.end = r->pos + len;
+    r->pos += len;
+
+    /* Sections of types that are gone, or lost their hook, are skipped. */
+    ti = object_find_loader(obj->class->type, name);
+    if (ti && !ti->load(obj, &section, version, &local_err)) {
+        if (local_err) {
+            error_propagate(&l->err, local_err);
+        } else if (!l->err) {
+            error_setg(&l->err, "truncated section");
+        }
+        error_prepend(&l->err, "%s version %u: ", name, version);
+        ok = false;
+    }
+
+    g_free(name);
+    return ok;
+}
+
+static bool object_load_properties(ObjectReader *r, Object *obj);
+
+static Object *object_load_record(ObjectReader *r, Object *into)
+{
+    ObjectLoader *l = r->loader;
+    ObjectClass *klass;
+    Object *obj;
+    char *name = NULL;
+    guint32 i, num_sections;
+    size_t size;
+
+    if (l->loaded == l->num_objects) {
+        error_setg(&l->err, "more objects than announced");
+        return NULL;
+    }
+
+    if (!object_reader_get_str(r, &name) || !name ||
+        !object_reader_get_u32(r, &num_sections)) {
+        error_setg(&l->err, "truncated object");
+        g_free(name);
+        return NULL;
+    }
+
+    if (into) {
+        if (strcmp(name, object_get_typename(into))) {
+            error_setg(&l->err, "cannot restore type '%s' into an object"
+                       " of type '%s'", name, object_get_typename(into));
+            g_free(name);
+            return NULL;
+        }
+        g_free(name);
+
+        obj = into;
+        object_ref(obj);
+    } else {
+        klass = object_class_by_name(name);
+        if (!klass || object_class_is_abstract(klass)) {
+            error_setg(&l->err, "cannot instantiate type '%s'", name);
+            g_free(name);
+            return NULL;
+        }
+        g_free(name);
+
+        /* The instance may have grown since the data was saved; then it
+         * no longer fits the block and gets its own allocation.
+         */
+        size = klass->type->instance_size;
+        obj = object_alloc_in_block(l, size);
+        if (obj) {
+            object_initialize(obj, size, klass->type->hdr.name);
+            qatomic_inc(&l->block->refs);
+            obj->free = object_block_free;
+        } else {
+            obj = object_new(klass->type->hdr.name);
+        }
+    }
+    l->objects[l->loaded++] = obj;
+
+    for (i = 0; i < num_sections; i++) {
+        if (!object_load_section(r, obj)) {
+            return NULL;
+        }
+    }
+
+    if (!object_load_properties(r, obj)) {
+        return NULL;
+    }
+
+    return obj;
+}
+
+bool object_reader_get_object(ObjectReader *r, Object **obj)
+{
+    ObjectLoader *l = r->loader;
+    Object *ret = NULL;
+    guint32 tag, index;
+
+    if (!object_reader_get_u32(r, &tag)) {
+        return false;
+    }
+
+    switch (tag) {
+    case OBJECT_TAG_NULL:
+        break;
+    case OBJECT_TAG_REF:
+        if (!object_reader_get_u32(r, &index)) {
+            return false;
+        }
+        if (index >= l->loaded) {
+            error_setg(&l->err, "reference to unknown object %u", index);
+            return false;
+        }
+        ret = l->objects[index];
+        object_ref(ret);
+        break;
+    case OBJECT_TAG_NEW:
+        ret = object_load_record(r, NULL);
+        if (!ret) {
+            return false;
+        }
+        object_ref(ret);
+        break;
+    default:
+        error_setg(&l->err, "bad object tag %u", tag);
+        return false;
+    }
+
+    *obj = ret;
+    return true;
+}
+
+static bool object_load_child(ObjectReader *r, Object *obj, const char *name)
+{
+    ObjectLoader *l = r->loader;
+    Error *local_err = NULL;
+    Object *child;
+    guint32 tag;
+
+    /* Children that instance_init created are restored in place. */
+    child = object_property_get_child(obj, name);
+    if (child) {
+        if (!object_reader_get_u32(r, &tag)) {
+            return false;
+        }
+        if (tag != OBJECT_TAG_NEW) {
+            error_setg(&l->err, "cannot restore into the existing child");
+            return false;
+        }
+        return object_load_record(r, child) != NULL;
+    }
+
+    if (!object_reader_get_object(r, &child)) {
+        return false;
+    }
+    if (!child) {
+        error_setg(&l->err, "child is null");
+        return false;
+    }
+
+    object_property_del(obj, name);
+    object_property_add_child(obj, name, child, &local_err);
+    object_unref(child);
+    if (local_err) {
+        error_propagate(&l->err, local_err);
+        return false;
+    }
+
+    return true;
+}
+
+static bool object_load_link(ObjectReader *r, Object *obj, const char *name)
+{
+    ObjectLoader *l = r->loader;
+    Error *local_err = NULL;
+    Object *target;
+
+    if (!object_reader_get_object(r, &target)) {
+        return false;
+    }
+    if (!target) {
+        error_setg(&l->err, "link is null");
+        return false;
+    }
+
+    /* A saved link replaces the property instance_init may have added. */
+    object_property_del(obj, name);
+    object_property_add_link(obj, name, target, &local_err);
+    object_unref(target);
+    if (local_err) {
+        error_propagate(&l->err, local_err);
+        return false;
+    }
+
+    return true;
+}
+
+static bool object_load_properties(ObjectReader *r, Object *obj)
+{
+    ObjectLoader *l = r->loader;
+    guint32 i, num_properties, kind;
+    char *name;
+    bool ok;
+
+    if (!object_reader_get_u32(r, &num_properties)) {
+        error_setg(&l->err, "truncated object");
+        return false;
+    }
+
+    for (i = 0; i < num_properties; i++) {
+        name = NULL;
+        if (!object_reader_get_str(r, &name) || !name ||
+            !object_reader_get_u32(r, &kind)) {
+            error_setg(&l->err, "truncated property");
+            g_free(name);
+            return false;
+        }
+
+        switch (kind) {
+        case OBJECT_PROPERTY_TAG_CHILD:
+            ok = object_load_child(r, obj, name);
+            break;
+        case OBJECT_PROPERTY_TAG_LINK:
+            ok = object_load_link(r, obj, name);
+            break;
+        default:
+            error_setg(&l->err, "bad property kind %u", kind);
+            ok = false;
+            break;
+        }
+
+        if (!ok) {
+            if (!l->err) {
+                error_setg(&l->err, "truncated property");
+            }
+            error_prepend(&l->err, "property '%s': ", name);
+            g_free(name);
+            return false;
+        }
+        g_free(name);
+    }
+
+    return true;
+}
+
+Object *object_deserialize(const void *buf, size_t size, Error **errp)
+{
+    ObjectStreamHeader hdr;
+    ObjectLoader l = { 0 };
+    ObjectReader r = { &l, (const char *)buf, (const char *)buf + size };
+    Object *obj = NULL;
+    size_t max_object;
+    guint32 i;
+
+    if (!object_reader_get_bytes(&r, &hdr, sizeof(hdr)) ||
+        memcmp(hdr.magic, OBJECT_STREAM_MAGIC, sizeof(OBJECT_STREAM_MAGIC)) ||
+        hdr.version != OBJECT_STREAM_VERSION) {
+        error_setg(errp, "not a version %d object stream",
+                   OBJECT_STREAM_VERSION);
+        return NULL;
+    }
+
+    /* Every object takes more than one byte of the stream, and no more of
+     * the block than an instance of the largest type.
+     */
+    max_object = OBJECT_BLOCK_SLOT +
+                 OBJECT_STREAM_ROUND(type_get_max_instance_size());
+    if (hdr.num_objects == 0 || hdr.num_objects > size ||
+        hdr.alloc_size % OBJECT_STREAM_ALIGN ||
+        hdr.alloc_size / hdr.num_objects > max_object ||
+        hdr.alloc_size > SIZE_MAX - OBJECT_BLOCK_HEADER) {
+        error_setg(errp, "corrupt object stream header");
+        return NULL;
+    }
+
+    /* The loader holds a reference to the block until it is done. */
+    l.block = g_malloc(OBJECT_BLOCK_HEADER + hdr.alloc_size);
+    l.block->refs = 1;
+    l.next = (char *)l.block + OBJECT_BLOCK_HEADER;
+    l.end = l.next + hdr.alloc_size;
+    l.objects = g_new0(Object *, hdr.num_objects);
+    l.num_objects = hdr.num_objects;
+
+    obj = object_load_record(&r, NULL);
+    if (!obj && !l.err) {
+        error_setg(&l.err, "truncated object stream");
+    }
+
+    /* Drop the references the loader took when creating the objects;
+     * the ones handed to load hooks keep the graph alive.
+     */
+    for (i = obj ? 1 : 0; i < l.loaded; i++) {
+        object_unref(l.objects[i]);
+    }
+    g_free(l.objects);
+    object_block_unref(l.block);
+
+    if (l.err) {
+        /* A hook may have ignored the failure of a nested object. */
+        if (obj) {
+            object_unref(obj);
+        }
+        error_propagate(errp, l.err);
+        return NULL;
+    }
+
+    return obj;
+}
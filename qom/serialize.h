@@ -0,0 +1,116 @@
+/*
+ * QEMU Object Model binary serialization
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+/*
+ * object_serialize() turns an object, and every object reachable through
+ * object_writer_put_object(), into a compact binary buffer;
+ * object_deserialize() rebuilds the graph from it.
+ *
+ * The buffer starts with a header holding the number of objects and the
+ * memory they need, so that loading allocates all objects in a single
+ * block.  Each object is its QOM typename followed by one section per
+ * type of its hierarchy that has a #TypeInfo.save hook, root type first.
+ * A section carries the typename, the #TypeInfo.version of the type when
+ * it was saved and the length of its payload.  Loading runs the
+ * instance_init chain first and then the #TypeInfo.load hooks, passing
+ * the saved version; sections of types that no longer exist, or have no
+ * load hook anymore, are skipped, and types without a section keep their
+ * instance_init state.  Integers are stored in host byte order.
+ *
+ * The sections are followed by the child and link properties of the
+ * object, whose targets are saved like object_writer_put_object() does.
+ * A child that instance_init already created is restored in place, and
+ * other saved properties replace those of the same name.  The parent of
+ * the serialized object is not saved, so it is restored detached.
+ */
+
+#ifndef QOM_SERIALIZE_H
+#define QOM_SERIALIZE_H
+
+#include <stdbool.h>
+#include "object.h"
+
+G_BEGIN_DECLS
+
+/**
+ * object_serialize:
+ * @obj: The object to serialize.
+ * @size: Returns the size of the buffer.
+ *
+ * Returns: A buffer holding @obj and the objects it references, to be
+ * freed with g_free().
+ */
+void *object_serialize(Object *obj, size_t *size);
+
+/**
+ * object_deserialize:
+ * @buf: A buffer returned by object_serialize().
+ * @size: The size of @buf.
+ * @errp: Returns an error if @buf is malformed or a load hook fails.
+ *
+ * The objects share one allocation, which is freed when the last of them
+ * is finalized.
+ *
+ * Returns: A new reference to the restored object, or %NULL on error.
+ */
+Object *object_deserialize(const void *buf, size_t size, Error **errp);
+
+/* Writer functions for #TypeInfo.save hooks. */
+void object_writer_put_u32(ObjectWriter *w, guint32 value);
+void object_writer_put_u64(ObjectWriter *w, guint64 value);
+void object_writer_put_bytes(ObjectWriter *w, const void *data, size_t len);
+
+/**
+ * object_writer_put_str:
+ * @w: The writer.
+ * @str: A string, or %NULL.
+ */
+void object_writer_put_str(ObjectWriter *w, const char *str);
+
+/**
+ * object_writer_put_object:
+ * @w: The writer.
+ * @obj: The referenced object, or %NULL.
+ *
+ * Serialize a reference to @obj.  Every object is saved once per buffer;
+ * further references to it, including cyclic ones, are restored as
+ * references to the same object.
+ */
+void object_writer_put_object(ObjectWriter *w, Object *obj);
+
+/*
+ * Reader functions for #TypeInfo.load hooks.  They return %false, and
+ * leave their result untouched, once the data of the section is
+ * exhausted; object_deserialize() then fails unless the hook already
+ * reported an error of its own.
+ */
+bool object_reader_get_u32(ObjectReader *r, guint32 *value);
+bool object_reader_get_u64(ObjectReader *r, guint64 *value);
+bool object_reader_get_bytes(ObjectReader *r, void *data, size_t len);
+
+/**
+ * object_reader_get_str:
+ * @r: The reader.
+ * @str: Returns a newly allocated copy of the string, or %NULL if %NULL
+ *   was saved.  Free it with g_free().
+ */
+bool object_reader_get_str(ObjectReader *r, char **str);
+
+/**
+ * object_reader_get_object:
+ * @r: The reader.
+ * @obj: Returns a new reference to the object, or %NULL if %NULL was
+ *   saved.  The caller owns the reference.
+ *
+ * A back reference to an object that is still being loaded returns that
+ * object, whose load hooks may not have run yet.
+ */
+bool object_reader_get_object(ObjectReader *r, Object **obj);
+
+G_END_DECLS
+
+#endif
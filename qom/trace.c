@@ -0,0 +1,125 @@
+/*
+ * QEMU Object Model tracepoints
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <string.h>
+#include <time.h>
+#include "atomic.h"
+#include "trace.h"
+
+#if defined(CONFIG_TRACE_RING)
+#define QOM_TRACE_DUMP_MAX QOM_TRACE_RING_SIZE
+#else
+#define QOM_TRACE_DUMP_MAX 1
+#endif
+
+#define QOM_TRACE_EVENT_NAME(id, name) #name,
+static const char *const trace_event_names[TRACE_EVENT_MAX] = {
+    QOM_TRACE_EVENTS(QOM_TRACE_EVENT_NAME)
+};
+#undef QOM_TRACE_EVENT_NAME
+
+const char *qom_trace_event_name(QomTraceEvent event)
+{
+    if (event >= TRACE_EVENT_MAX) {
+        return "unknown";
+    }
+    return trace_event_names[event];
+}
+
+#if defined(CONFIG_TRACE_RING)
+
+bool qom_trace_enabled;
+
+/*
+ * Writers claim a slot with an atomic increment of trace_ring_head, so
+ * recording never takes a lock.  A dump that races with writers may see
+ * a partially written record; it is meant for inspection, not replay.
+ */
+static QomTraceRecord trace_ring[QOM_TRACE_RING_SIZE];
+static guint64 trace_ring_head;
+
+void qom_trace_set_enabled(bool enabled)
+{
+    qom_trace_enabled = enabled;
+}
+
+void qom_trace_record(QomTraceEvent event, const char *name,
+                      const void *ptr, const char *detail)
+{
+    guint64 idx = qatomic_fetch_inc(&trace_ring_head);
+    QomTraceRecord *rec = &trace_ring[idx % QOM_TRACE_RING_SIZE];
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    rec->ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    rec->event = event;
+    rec->name = name;
+    rec->ptr = ptr;
+    rec->detail = detail;
+}
+
+int qom_trace_snapshot(QomTraceRecord *records, int max)
+{
+    guint64 head = qatomic_load_acquire(&trace_ring_head);
+    guint64 first = head > QOM_TRACE_RING_SIZE ? head - QOM_TRACE_RING_SIZE : 0;
+    guint64 i;
+    int n = 0;
+
+    if (head - first > (guint64)max) {
+        first = head - max;
+    }
+
+    for (i = first; i < head; i++) {
+        records[n++] = trace_ring[i % QOM_TRACE_RING_SIZE];
+    }
+
+    return n;
+}
+
+#else
+
+void qom_trace_set_enabled(bool enabled)
+{
+}
+
+int qom_trace_snapshot(QomTraceRecord *records, int max)
+{
+    return 0;
+}
+
+#endif
+
+void qom_trace_dump(FILE *out)
+{
+    QomTraceRecord *records = g_new(QomTraceRecord, QOM_TRACE_DUMP_MAX);
+    int n = qom_trace_snapshot(records, QOM_TRACE_DUMP_MAX);
+    int i, j;
+
+    for (i = 0; i < n; i++) {
+        QomTraceRecord *rec = &records[i];
+
+        fprintf(out, "%llu %s %s %p", rec->ns,
+                qom_trace_event_name(rec->event), rec->name, rec->ptr);
+        if (rec->detail) {
+            fprintf(out, " %s", rec->detail);
+        }
+
+        /* Pair class_init end with its start to show the duration. */
+        if (rec->event == TRACE_CLASS_INIT_END) {
+            for (j = i - 1; j >= 0; j--) {
+                if (records[j].event == TRACE_CLASS_INIT_START &&
+                    records[j].ptr == rec->ptr) {
+                    fprintf(out, " (%llu ns)", rec->ns - records[j].ns);
+                    break;
+                }
+            }
+        }
+        fputc('\n', out);
+    }
+
+    g_free(records);
+}
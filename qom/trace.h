@@ -0,0 +1,144 @@
+/*
+ * QEMU Object Model tracepoints
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+/*
+ * Static tracepoints in the type and object life cycle.  The backend is
+ * selected at build time:
+ *
+ *  - default:             every tracepoint compiles to nothing.
+ *  - CONFIG_TRACE_RING:   events are recorded in an in-process ring
+ *                         buffer that can be dumped with qom_trace_dump().
+ *                         Recording is off until qom_trace_set_enabled().
+ *  - CONFIG_TRACE_DTRACE: events are USDT probes in the "qom" provider,
+ *                         for use with SystemTap, bpftrace or DTrace.
+ */
+
+#ifndef QOM_TRACE_H
+#define QOM_TRACE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "glib.h"
+
+G_BEGIN_DECLS
+
+/* Event id, probe name */
+#define QOM_TRACE_EVENTS(E)                     \
+    E(TRACE_TYPE_REGISTER, type_register)       \
+    E(TRACE_CLASS_INIT_START, class_init_start) \
+    E(TRACE_CLASS_INIT_END, class_init_end)     \
+    E(TRACE_OBJECT_INIT, object_init)           \
+    E(TRACE_OBJECT_FINALIZE, object_finalize)   \
+    E(TRACE_OBJECT_CAST_FAIL, object_cast_fail)
+
+#define QOM_TRACE_EVENT_ID(id, name) id,
+typedef enum QomTraceEvent {
+    QOM_TRACE_EVENTS(QOM_TRACE_EVENT_ID)
+    TRACE_EVENT_MAX
+} QomTraceEvent;
+#undef QOM_TRACE_EVENT_ID
+
+/**
+ * QomTraceRecord:
+ * @ns: CLOCK_MONOTONIC timestamp of the event.
+ * @event: the #QomTraceEvent.
+ * @name: the type name the event is about.
+ * @ptr: the object or class the event is about, if any.
+ * @detail: event specific text, e.g. the target type of a failed cast.
+ */
+typedef struct QomTraceRecord {
+    guint64 ns;
+    QomTraceEvent event;
+    const char *name;
+    const void *ptr;
+    const char *detail;
+} QomTraceRecord;
+
+#if defined(CONFIG_TRACE_RING)
+
+/* Number of records kept, older records are overwritten. */
+#define QOM_TRACE_RING_SIZE 4096
+
+extern bool qom_trace_enabled;
+
+void qom_trace_record(QomTraceEvent event, const char *name,
+                      const void *ptr, const char *detail);
+
+#define QOM_TRACE(event, probe, name, ptr, detail)                      \
+    G_STMT_START {                                                      \
+        if (G_UNLIKELY(qom_trace_enabled)) {                            \
+            qom_trace_record((event), (name), (ptr), (detail));         \
+        }                                                               \
+    } G_STMT_END
+
+#elif defined(CONFIG_TRACE_DTRACE)
+
+#include <sys/sdt.h>
+
+#define QOM_TRACE(event, probe, name, ptr, detail)                      \
+    DTRACE_PROBE3(qom, probe, (name), (ptr), (detail))
+
+#else
+
+#define QOM_TRACE(event, probe, name, ptr, detail)                      \
+    G_STMT_START { (void) 0; } G_STMT_END
+
+#endif
+
+#define trace_type_register(name) \
+    QOM_TRACE(TRACE_TYPE_REGISTER, type_register, name, NULL, NULL)
+#define trace_class_init_start(name, klass) \
+    QOM_TRACE(TRACE_CLASS_INIT_START, class_init_start, name, klass, NULL)
+#define trace_class_init_end(name, klass) \
+    QOM_TRACE(TRACE_CLASS_INIT_END, class_init_end, name, klass, NULL)
+#define trace_object_init(name, obj) \
+    QOM_TRACE(TRACE_OBJECT_INIT, object_init, name, obj, NULL)
+#define trace_object_finalize(name, obj) \
+    QOM_TRACE(TRACE_OBJECT_FINALIZE, object_finalize, name, obj, NULL)
+#define trace_object_cast_fail(name, ptr, target) \
+    QOM_TRACE(TRACE_OBJECT_CAST_FAIL, object_cast_fail, name, ptr, target)
+
+/**
+ * qom_trace_set_enabled:
+ * @enabled: whether to record events.
+ *
+ * Start or stop recording into the ring buffer.  Does nothing unless
+ * the ring buffer backend is built in.
+ */
+void qom_trace_set_enabled(bool enabled);
+
+/**
+ * qom_trace_snapshot:
+ * @records: array to fill.
+ * @max: number of entries available at @records.
+ *
+ * Copy the most recent recorded events, oldest first.
+ *
+ * Returns: the number of records copied.
+ */
+int qom_trace_snapshot(QomTraceRecord *records, int max);
+
+/**
+ * qom_trace_dump:
+ * @out: stream to write to.
+ *
+ * Print the recorded events, oldest first.  The end of a class
+ * initialization also shows how long class_init took.
+ */
+void qom_trace_dump(FILE *out);
+
+/**
+ * qom_trace_event_name:
+ * @event: a #QomTraceEvent.
+ *
+ * Returns: the probe name of @event.
+ */
+const char *qom_trace_event_name(QomTraceEvent event);
+
+G_END_DECLS
+
+#endif
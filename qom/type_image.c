@@ -0,0 +1,430 @@
+/*
+ * QEMU Object Model precompiled type image
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "object.h"
+#include "object_int.h"
+#include "type_image.h"
+
+#define TYPE_IMAGE_MAGIC "QOMTIMG"
+#define TYPE_IMAGE_VERSION 1
+
+#define TYPE_IMAGE_ABSTRACT (1u << 0)
+#define TYPE_IMAGE_FINAL    (1u << 1)
+
+/*
+ * Layout: the header, the entries sorted by name, the interface table
+ * (entry indices), the ancestry bitsets (bitset_words 64-bit words per
+ * entry, bit i set if entry i is the type itself or one of its
+ * ancestors) and the NUL-separated names.  All sections are 8-byte
+ * aligned and in host byte order.
+ */
+typedef struct TypeImageHeader {
+    char magic[8];
+    guint32 version;
+    guint32 num_types;
+    guint32 bitset_words;
+    guint32 types_offset;
+    guint32 interfaces_offset;
+    guint32 ancestry_offset;
+    guint32 strings_offset;
+    guint32 size;
+} TypeImageHeader;
+
+struct TypeImageEntry {
+    guint32 name;
+    gint32 parent;
+    guint64 instance_size;
+    guint64 class_size;
+    guint32 flags;
+    guint32 num_interfaces;
+    guint32 interfaces;
+    guint32 reserved;
+};
+
+#define TYPE_IMAGE_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+static const TypeImageHeader *type_image;
+
+static const TypeImageEntry *type_image_entries(const TypeImageHeader *hdr)
+{
+    return (const TypeImageEntry *)((const char *)hdr + hdr->types_offset);
+}
+
+static const char *type_image_strings(const TypeImageHeader *hdr)
+{
+    return (const char *)hdr + hdr->strings_offset;
+}
+
+static void type_image_collect(ObjectClass *klass, void *opaque)
+{
+    GSList **list = opaque;
+
+    *list = g_slist_prepend(*list, klass->type);
+}
+
+static gint type_image_compare_types(gconstpointer a, gconstpointer b)
+{
+    const TypeImpl *ta = a, *tb = b;
+
+    return strcmp(ta->hdr.name, tb->hdr.name);
+}
+
+bool type_image_write(const char *path, Error **errp)
+{
+    GSList *list = NULL, *e;
+    GHashTable *indices;
+    TypeImageHeader *hdr;
+    TypeImageEntry *entries;
+    TypeImpl **types;
+    guint32 *interfaces;
+    guint64 *ancestry;
+    char *buf, *strings, *tmp_path;
+    size_t num_types, num_interfaces = 0, strings_size = 0, size;
+    size_t words, n_iface = 0, str = 0, i;
+    FILE *f;
+    bool ok;
+
+    object_class_foreach(type_image_collect, NULL, true, &list);
+    list = g_slist_sort(list, type_image_compare_types);
+
+    num_types = g_slist_length(list);
+    words = (num_types + 63) / 64;
+    types = g_new(TypeImpl *, num_types);
+    indices = g_hash_table_new(g_str_hash, g_str_equal);
+    for (e = list, i = 0; e; e = e->next, i++) {
+        types[i] = e->data;
+        g_hash_table_insert(indices, (void *)types[i]->hdr.name,
+                            GINT_TO_POINTER(i + 1));
+        num_interfaces += types[i]->num_interfaces;
+        strings_size += strlen(types[i]->hdr.name) + 1;
+    }
+    g_slist_free(list);
+
+    /* An image that refers to an unknown type would not load at all. */
+    for (i = 0; i < num_types; i++) {
+        int j;
+
+        for (j = 0; j < types[i]->num_interfaces; j++) {
+            const char *iface = types[i]->interfaces[j].typename;
+
+            if (!g_hash_table_lookup(indices, iface)) {
+                error_setg(errp, "type '%s' implements unregistered "
+                           "interface '%s'", types[i]->hdr.name, iface);
+                g_hash_table_destroy(indices);
+                g_free(types);
+                return false;
+            }
+        }
+    }
+
+    hdr = NULL;
+    size = TYPE_IMAGE_ALIGN(sizeof(*hdr));
+    size += num_types * sizeof(*entries);
+    size += TYPE_IMAGE_ALIGN(num_interfaces * sizeof(*interfaces));
+    size += num_types * words * sizeof(*ancestry);
+    size += TYPE_IMAGE_ALIGN(strings_size);
+
+    buf = g_malloc0(size);
+    hdr = (TypeImageHeader *)buf;
+    memcpy(hdr->magic, TYPE_IMAGE_MAGIC, sizeof(TYPE_IMAGE_MAGIC));
+    hdr->version = TYPE_IMAGE_VERSION;
+    hdr->num_types = num_types;
+    hdr->bitset_words = words;
+    hdr->types_offset = TYPE_IMAGE_ALIGN(sizeof(*hdr));
+    hdr->interfaces_offset = hdr->types_offset +
+                             num_types * sizeof(*entries);
+    hdr->ancestry_offset = hdr->interfaces_offset +
+        TYPE_IMAGE_ALIGN(num_interfaces * sizeof(*interfaces));
+    hdr->strings_offset = hdr->ancestry_offset +
+                          num_types * words * sizeof(*ancestry);
+    hdr->size = size;
+
+    entries = (TypeImageEntry *)(buf + hdr->types_offset);
+    interfaces = (guint32 *)(buf + hdr->interfaces_offset);
+    ancestry = (guint64 *)(buf + hdr->ancestry_offset);
+    strings = buf + hdr->strings_offset;
+
+    for (i = 0; i < num_types; i++) {
+        TypeImpl *ti = types[i], *t;
+        guint64 *bits = ancestry + i * words;
+        size_t len = strlen(ti->hdr.name) + 1;
+        int j;
+
+        entries[i].name = str;
+        memcpy(strings + str, ti->hdr.name, len);
+        str += len;
+
+        entries[i].parent = ti->parent_type ?
+            GPOINTER_TO_INT(g_hash_table_lookup(
+                                indices, ti->parent_type->hdr.name)) - 1 :
+            -1;
+        entries[i].instance_size = ti->instance_size;
+        entries[i].class_size = ti->class_size;
+        entries[i].flags = (ti->hdr.abstract ? TYPE_IMAGE_ABSTRACT : 0) |
+                           (ti->hdr.final ? TYPE_IMAGE_FINAL : 0);
+
+        entries[i].num_interfaces = ti->num_interfaces;
+        entries[i].interfaces = n_iface;
+        for (j = 0; j < ti->num_interfaces; j++) {
+            interfaces[n_iface++] = GPOINTER_TO_INT(
+                g_hash_table_lookup(indices, ti->interfaces[j].typename)) - 1;
+        }
+
+        for (t = ti; t; t = t->parent_type) {
+            int idx = GPOINTER_TO_INT(g_hash_table_lookup(indices,
+                                                          t->hdr.name)) - 1;
+
+            bits[idx / 64] |= 1ULL << (idx % 64);
+        }
+    }
+
+    g_hash_table_destroy(indices);
+    g_free(types);
+
+    /* Write a temporary file and rename it, so that processes mapping
+     * the image never see a partial one.
+     */
+    tmp_path = g_strdup_printf("%s.tmp", path);
+    f = fopen(tmp_path, "wb");
+    if (!f) {
+        error_setg(errp, "cannot create '%s': %s", tmp_path, strerror(errno));
+        ok = false;
+    } else {
+        ok = fwrite(buf, size, 1, f) == 1;
+        ok = fclose(f) == 0 && ok;
+        if (ok && rename(tmp_path, path) != 0) {
+            ok = false;
+        }
+        if (!ok) {
+            error_setg(errp, "cannot write '%s': %s", path, strerror(errno));
+            unlink(tmp_path);
+        }
+    }
+
+    g_free(tmp_path);
+    g_free(buf);
+
+    return ok;
+}
+
+static bool type_image_check(const TypeImageHeader *hdr, size_t size,
+                             Error **errp)
+{
+    const TypeImageEntry *entries;
+    const guint32 *interfaces;
+    const char *strings;
+    guint64 n, words, strings_size;
+    guint32 i, j;
+
+    if (size < sizeof(*hdr) ||
+        memcmp(hdr->magic, TYPE_IMAGE_MAGIC, sizeof(TYPE_IMAGE_MAGIC)) ||
+        hdr->version != TYPE_IMAGE_VERSION || hdr->size != size) {
+        error_setg(errp, "not a version %d type image", TYPE_IMAGE_VERSION);
+        return false;
+    }
+
+    n = hdr->num_types;
+    words = hdr->bitset_words;
+    if (words != (n + 63) / 64 || hdr->types_offset < sizeof(*hdr) ||
+        hdr->types_offset % 8 || hdr->interfaces_offset % 8 ||
+        hdr->ancestry_offset % 8 ||
+        hdr->types_offset + n * sizeof(*entries) > hdr->interfaces_offset ||
+        hdr->interfaces_offset > hdr->ancestry_offset ||
+        hdr->ancestry_offset + n * words * 8 > hdr->strings_offset ||
+        hdr->strings_offset >= size) {
+        error_setg(errp, "corrupt type image layout");
+        return false;
+    }
+
+    strings_size = size - hdr->strings_offset;
+    strings = type_image_strings(hdr);
+    entries = type_image_entries(hdr);
+    interfaces = (const guint32 *)((const char *)hdr + hdr->interfaces_offset);
+    for (i = 0; i < n; i++) {
+        if (entries[i].name >= strings_size ||
+            !memchr(strings + entries[i].name, '\0',
+                    strings_size - entries[i].name) ||
+            entries[i].parent < -1 || entries[i].parent >= (gint64)n ||
+            (hdr->interfaces_offset +
+             ((guint64)entries[i].interfaces + entries[i].num_interfaces) *
+             sizeof(guint32)) > hdr->ancestry_offset) {
+            error_setg(errp, "corrupt type image entry %u", i);
+            return false;
+        }
+
+        /* type_image_lookup() does a binary search. */
+        if (i > 0 && strcmp(strings + entries[i - 1].name,
+                            strings + entries[i].name) >= 0) {
+            error_setg(errp, "type image entries are not sorted");
+            return false;
+        }
+
+        for (j = 0; j < entries[i].num_interfaces; j++) {
+            if (interfaces[entries[i].interfaces + j] >= n) {
+                error_setg(errp, "corrupt type image entry %u", i);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool type_image_load(const char *path, Error **errp)
+{
+    struct stat st;
+    void *map;
+    int fd;
+
+    if (type_image) {
+        error_setg(errp, "a type image is already loaded");
+        return false;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        error_setg(errp, "cannot open '%s': %s", path, strerror(errno));
+        return false;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        error_setg(errp, "cannot map '%s': empty or unreadable", path);
+        close(fd);
+        return false;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        error_setg(errp, "cannot map '%s': %s", path, strerror(errno));
+        return false;
+    }
+
+    if (!type_image_check(map, st.st_size, errp)) {
+        error_prepend(errp, "'%s': ", path);
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    type_image = map;
+
+    return true;
+}
+
+const TypeImageEntry *type_image_lookup(const char *name)
+{
+    const TypeImageEntry *entries;
+    const char *strings;
+    guint32 lo = 0, hi;
+
+    if (!type_image) {
+        return NULL;
+    }
+
+    entries = type_image_entries(type_image);
+    strings = type_image_strings(type_image);
+    hi = type_image->num_types;
+    while (lo < hi) {
+        guint32 mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(name, strings + entries[mid].name);
+
+        if (cmp == 0) {
+            return &entries[mid];
+        }
+        if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    return NULL;
+}
+
+const char *type_image_entry_name(const TypeImageEntry *entry)
+{
+    return type_image_strings(type_image) + entry->name;
+}
+
+const char *type_image_entry_parent(const TypeImageEntry *entry)
+{
+    if (entry->parent < 0) {
+        return NULL;
+    }
+
+    return type_image_entry_name(&type_image_entries(type_image)[entry->parent]);
+}
+
+int type_image_entry_index(const TypeImageEntry *entry)
+{
+    return entry - type_image_entries(type_image);
+}
+
+const guint64 *type_image_entry_ancestry(const TypeImageEntry *entry)
+{
+    const guint64 *ancestry = (const guint64 *)((const char *)type_image +
+                                                type_image->ancestry_offset);
+
+    return ancestry + type_image_entry_index(entry) * type_image->bitset_words;
+}
+
+static const TypeImageEntry *type_image_entry_at(gint32 index)
+{
+    return index < 0 ? NULL : &type_image_entries(type_image)[index];
+}
+
+bool type_image_entry_matches(const TypeImageEntry *entry,
+                              const TypeInfo *info)
+{
+    const TypeImageEntry *parent = type_image_entry_at(entry->parent);
+    const guint32 *interfaces;
+    guint64 instance_size, class_size;
+    bool abstract;
+    guint32 i;
+
+    if (!info->parent || !parent) {
+        if (info->parent || parent) {
+            return false;
+        }
+    } else if (strcmp(info->parent, type_image_entry_name(parent)) != 0) {
+        return false;
+    }
+
+    /* The image holds the sizes as resolved by type_initialize(). */
+    instance_size = info->instance_size ? info->instance_size :
+                    parent ? parent->instance_size : 0;
+    class_size = info->class_size ? info->class_size :
+                 parent ? parent->class_size : sizeof(ObjectClass);
+    abstract = info->abstract || instance_size == 0;
+    if (entry->instance_size != instance_size ||
+        entry->class_size != class_size ||
+        !(entry->flags & TYPE_IMAGE_ABSTRACT) != !abstract ||
+        !(entry->flags & TYPE_IMAGE_FINAL) != !info->final) {
+        return false;
+    }
+
+    interfaces = (const guint32 *)((const char *)type_image +
+                                   type_image->interfaces_offset);
+    for (i = 0; i < entry->num_interfaces; i++) {
+        if (!info->interfaces || !info->interfaces[i].type ||
+            strcmp(info->interfaces[i].type,
+                   type_image_entry_name(type_image_entry_at(
+                       interfaces[entry->interfaces + i]))) != 0) {
+            return false;
+        }
+    }
+
+    return !info->interfaces || !info->interfaces[i].type;
+}
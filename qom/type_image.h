@@ -0,0 +1,78 @@
+/*
+ * QEMU Object Model precompiled type image
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+/*
+ * A type image is a snapshot of the type hierarchy that a process can
+ * write once, e.g. at build or install time, and map read-only on later
+ * starts.  It holds the type names, parent links, resolved instance and
+ * class sizes, declared interfaces and, for every type, a bitset of its
+ * ancestors.  Everything is addressed by offsets and indices, so the
+ * file works at any address.
+ *
+ * Function pointers cannot come from a file: types are still registered
+ * through their #TypeInfo, and type_register() looks the name up in the
+ * loaded image.  When the image agrees with the #TypeInfo on the parent,
+ * the instance and class sizes, the abstract and final flags and the
+ * interfaces, the type takes its name, parent name and ancestry from the
+ * image.
+ * Names then need no copying, and type_is_ancestor() becomes a single
+ * bit test instead of a walk up the parent chain.  Types the image does
+ * not know, or knows with a different parent, behave as without an
+ * image.
+ */
+
+#ifndef QOM_TYPE_IMAGE_H
+#define QOM_TYPE_IMAGE_H
+
+#include <stdbool.h>
+#include "glib.h"
+#include "error.h"
+#include "object.h"
+
+G_BEGIN_DECLS
+
+typedef struct TypeImageEntry TypeImageEntry;
+
+/**
+ * type_image_write:
+ * @path: The file to write.
+ * @errp: Returns an error if the file cannot be written.
+ *
+ * Write an image of all registered types to @path.  This initializes all
+ * classes, so call it once the program has registered its types.
+ *
+ * Returns: %true on success.
+ */
+bool type_image_write(const char *path, Error **errp);
+
+/**
+ * type_image_load:
+ * @path: The image file.
+ * @errp: Returns an error if the file cannot be mapped or is not a valid
+ *   image.
+ *
+ * Map the image at @path for the types registered from now on.  Call it
+ * before registering any type.  A missing or stale image only costs the
+ * speedup, so callers will typically ignore the error and write a new
+ * image.
+ *
+ * Returns: %true on success.
+ */
+bool type_image_load(const char *path, Error **errp);
+
+/* Used by type registration, not meant to be called directly. */
+const TypeImageEntry *type_image_lookup(const char *name);
+const char *type_image_entry_name(const TypeImageEntry *entry);
+const char *type_image_entry_parent(const TypeImageEntry *entry);
+int type_image_entry_index(const TypeImageEntry *entry);
+bool type_image_entry_matches(const TypeImageEntry *entry,
+                              const TypeInfo *info);
+const guint64 *type_image_entry_ancestry(const TypeImageEntry *entry);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,288 @@
+/*
+ * Tests for object_clone() and types initialized from a prototype
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <string.h>
+#include "../qom/object.h"
+
+#define TYPE_TEST_NODE "test-node"
+#define TYPE_TEST_DEVICE "test-device"
+#define TYPE_TEST_PROTO_NODE "test-proto-node"
+#define TYPE_TEST_PROTO_DEVICE "test-proto-device"
+
+typedef struct TestNode {
+    Object parent;
+
+    guint32 value;
+    char *label;
+    Object *peer;
+} TestNode;
+
+typedef struct TestDevice {
+    TestNode parent;
+
+    /* Created by instance_init as the child "bus". */
+    TestNode *bus;
+} TestDevice;
+
+#define TEST_NODE(obj) OBJECT_CHECK(TestNode, obj, TYPE_TEST_NODE)
+#define TEST_DEVICE(obj) OBJECT_CHECK(TestDevice, obj, TYPE_TEST_DEVICE)
+
+static void test_node_finalize(Object *obj)
+{
+    TestNode *node = TEST_NODE(obj);
+
+    g_free(node->label);
+    if (node->peer) {
+        object_unref(node->peer);
+    }
+}
+
+static void test_device_init(Object *obj)
+{
+    TestDevice *dev = TEST_DEVICE(obj);
+
+    dev->bus = TEST_NODE(object_new(TYPE_TEST_NODE));
+    object_property_add_child(obj, "bus", OBJECT(dev->bus), &error_abort);
+    object_unref(OBJECT(dev->bus));
+}
+
+static int test_proto_inits;
+static int test_proto_serial;
+
+static void test_proto_node_init(Object *obj)
+{
+    TestNode *node = TEST_NODE(obj);
+
+    test_proto_inits++;
+    node->value = 11;
+    node->label = g_strdup("proto");
+}
+
+static void test_proto_node_post_copy(Object *obj)
+{
+    TEST_NODE(obj)->value += ++test_proto_serial;
+}
+
+static void test_proto_device_init(Object *obj)
+{
+    test_proto_inits++;
+}
+
+static const ObjectCopyField test_node_copy_fields[] = {
+    OBJECT_COPY_FIELD(OBJECT_COPY_STRING, TestNode, label),
+    OBJECT_COPY_FIELD(OBJECT_COPY_REF, TestNode, peer),
+    { OBJECT_COPY_END },
+};
+
+static const ObjectCopyField test_device_copy_fields[] = {
+    OBJECT_COPY_FIELD(OBJECT_COPY_CHILD, TestDevice, bus),
+    { OBJECT_COPY_END },
+};
+
+static const TypeInfo test_node_info = {
+    .name = TYPE_TEST_NODE,
+    .parent = TYPE_OBJECT,
+    .instance_size = sizeof(TestNode),
+    .instance_finalize = test_node_finalize,
+    .copy_fields = test_node_copy_fields,
+};
+
+static const TypeInfo test_device_info = {
+    .name = TYPE_TEST_DEVICE,
+    .parent = TYPE_TEST_NODE,
+    .instance_size = sizeof(TestDevice),
+    .instance_init = test_device_init,
+    .copy_fields = test_device_copy_fields,
+};
+
+static const TypeInfo test_proto_node_info = {
+    .name = TYPE_TEST_PROTO_NODE,
+    .parent = TYPE_TEST_NODE,
+    .instance_init = test_proto_node_init,
+    .prototype = true,
+    .instance_post_copy = test_proto_node_post_copy,
+};
+
+static const TypeInfo test_proto_device_info = {
+    .name = TYPE_TEST_PROTO_DEVICE,
+    .parent = TYPE_TEST_DEVICE,
+    .instance_init = test_proto_device_init,
+    .prototype = true,
+};
+
+static TestNode *test_node_new(guint32 value, const char *label)
+{
+    TestNode *node = TEST_NODE(object_new(TYPE_TEST_NODE));
+
+    node->value = value;
+    node->label = g_strdup(label);
+    return node;
+}
+
+static void test_fields(void)
+{
+    TestNode *peer = test_node_new(1, "peer");
+    TestNode *node = test_node_new(2, "node");
+    TestNode *copy;
+
+    node->peer = OBJECT(peer);
+    object_ref(node->peer);
+
+    copy = TEST_NODE(object_clone(OBJECT(node)));
+    g_assert_cmpint(copy->value, ==, 2);
+    g_assert(copy->label != node->label && !strcmp(copy->label, "node"));
+    g_assert(copy->peer == OBJECT(peer));
+
+    object_unref(OBJECT(node));
+    object_unref(OBJECT(copy));
+    object_unref(OBJECT(peer));
+}
+
+static void test_children(void)
+{
+    TestDevice *dev = TEST_DEVICE(object_new(TYPE_TEST_DEVICE));
+    TestNode *extra = test_node_new(7, "extra");
+    TestNode *leaf = test_node_new(8, "leaf");
+    TestNode *outside = test_node_new(9, "outside");
+    Object *copy_extra, *copy_leaf;
+    TestDevice *copy;
+
+    dev->bus->value = 5;
+    object_property_add_child(OBJECT(dev), "extra", OBJECT(extra),
+                              &error_abort);
+    object_property_add_child(OBJECT(extra), "leaf", OBJECT(leaf),
+                              &error_abort);
+    object_property_add_link(OBJECT(dev), "outside", OBJECT(outside),
+                             &error_abort);
+    object_property_add_link(OBJECT(dev), "primary", OBJECT(dev->bus),
+                             &error_abort);
+
+    copy = TEST_DEVICE(object_clone(OBJECT(dev)));
+
+    /* Children are copies, attached to the clone. */
+    g_assert(copy->bus != dev->bus);
+    g_assert(object_resolve_path_component(OBJECT(copy), "bus") ==
+             OBJECT(copy->bus));
+    g_assert(OBJECT(copy->bus)->parent == OBJECT(copy));
+    g_assert_cmpint(copy->bus->value, ==, 5);
+
+    copy_extra = object_resolve_path_component(OBJECT(copy), "extra");
+    g_assert(copy_extra != NULL && copy_extra != OBJECT(extra));
+    g_assert(copy_extra->parent == OBJECT(copy));
+    g_assert(!strcmp(TEST_NODE(copy_extra)->label, "extra"));
+
+    copy_leaf = object_resolve_path_component(copy_extra, "leaf");
+    g_assert(copy_leaf != NULL && copy_leaf != OBJECT(leaf));
+    g_assert(copy_leaf->parent == copy_extra);
+    g_assert_cmpint(TEST_NODE(copy_leaf)->value, ==, 8);
+
+    /* Links point to the same objects as in the source. */
+    g_assert(object_resolve_path_component(OBJECT(copy), "outside") ==
+             OBJECT(outside));
+    g_assert(object_resolve_path_component(OBJECT(copy), "primary") ==
+             OBJECT(dev->bus));
+
+    /* The clone does not depend on the source. */
+    object_unref(OBJECT(leaf));
+    object_unref(OBJECT(extra));
+    object_unref(OBJECT(dev));
+    g_assert_cmpint(TEST_NODE(copy_leaf)->value, ==, 8);
+
+    object_unref(OBJECT(copy));
+    object_unref(OBJECT(outside));
+}
+
+static void test_detached(void)
+{
+    Object *parent = object_new(TYPE_TEST_DEVICE);
+    TestNode *node = test_node_new(3, "node");
+    Object *copy;
+
+    object_property_add_child(parent, "node", OBJECT(node), &error_abort);
+
+    copy = object_clone(OBJECT(node));
+    g_assert(copy->parent == NULL);
+    g_assert(OBJECT(node)->parent == parent);
+
+    object_unref(copy);
+    object_unref(OBJECT(node));
+    object_unref(parent);
+}
+
+static void test_prototype(void)
+{
+    TestNode *a, *b, *copy;
+
+    /* Neither registering nor initializing the class builds it. */
+    g_assert(object_class_by_name(TYPE_TEST_PROTO_NODE) != NULL);
+    g_assert_cmpint(test_proto_inits, ==, 0);
+
+    a = TEST_NODE(object_new(TYPE_TEST_PROTO_NODE));
+    b = TEST_NODE(object_new(TYPE_TEST_PROTO_NODE));
+    g_assert_cmpint(test_proto_inits, ==, 1);
+
+    /* Copies of the prototype equal what instance_init produces, plus
+     * what instance_post_copy does per object.
+     */
+    g_assert_cmpint(a->value, ==, 11 + 1);
+    g_assert_cmpint(b->value, ==, 11 + 2);
+    g_assert(a->label != b->label);
+    g_assert(!strcmp(a->label, "proto") && !strcmp(b->label, "proto"));
+    g_assert(a->peer == NULL);
+    g_assert_cmpint(g_hash_table_size(OBJECT(a)->properties), ==, 0);
+
+    copy = TEST_NODE(object_clone(OBJECT(a)));
+    g_assert_cmpint(copy->value, ==, a->value);
+    g_assert(!strcmp(copy->label, a->label));
+
+    object_unref(OBJECT(copy));
+    object_unref(OBJECT(b));
+    object_unref(OBJECT(a));
+}
+
+static void test_prototype_children(void)
+{
+    TestDevice *a, *b;
+
+    test_proto_inits = 0;
+    a = TEST_DEVICE(object_new(TYPE_TEST_PROTO_DEVICE));
+    b = TEST_DEVICE(object_new(TYPE_TEST_PROTO_DEVICE));
+
+    /* The instance_init of test-device adds a child, so after the
+     * dropped prototype every object runs the chain.
+     */
+    g_assert_cmpint(test_proto_inits, ==, 3);
+    g_assert(a->bus != b->bus);
+    g_assert(object_resolve_path_component(OBJECT(a), "bus") ==
+             OBJECT(a->bus));
+    g_assert(object_resolve_path_component(OBJECT(b), "bus") ==
+             OBJECT(b->bus));
+    g_assert(OBJECT(b->bus)->parent == OBJECT(b));
+
+    object_unref(OBJECT(b));
+    object_unref(OBJECT(a));
+}
+
+int main(void)
+{
+    object_type_register();
+    type_register_static(&test_node_info);
+    type_register_static(&test_device_info);
+    type_register_static(&test_proto_node_info);
+    type_register_static(&test_proto_device_info);
+
+    test_fields();
+    test_children();
+    test_detached();
+
+    /* Prototypes are built after the type pages are protected. */
+    type_registry_freeze();
+    test_prototype();
+    test_prototype_children();
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * Tests for the composition tree and its path index
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <string.h>
+#include "../qom/object.h"
+
+#define TYPE_TEST_OBJECT "test-object"
+
+static int test_unparented;
+
+static void test_object_unparent(Object *obj)
+{
+    test_unparented++;
+}
+
+static void test_object_class_init(ObjectClass *klass, void *data)
+{
+    klass->unparent = test_object_unparent;
+}
+
+static const TypeInfo test_object_info = {
+    .name = TYPE_TEST_OBJECT,
+    .parent = TYPE_OBJECT,
+    .instance_size = sizeof(Object),
+    .class_init = test_object_class_init,
+};
+
+static void assert_path(Object *obj, const char *path)
+{
+    char *canonical = object_get_canonical_path(obj);
+
+    if (path) {
+        g_assert(canonical != NULL && !strcmp(canonical, path));
+        g_assert(object_resolve_path(path) == obj);
+    } else {
+        g_assert(canonical == NULL);
+    }
+    g_free(canonical);
+}
+
+/* Returns a new object with the child "a" and the grandchild "a/b". */
+static Object *test_tree_new(Object **a, Object **b)
+{
+    Object *obj = object_new(TYPE_TEST_OBJECT);
+
+    *a = object_new(TYPE_TEST_OBJECT);
+    *b = object_new(TYPE_TEST_OBJECT);
+    object_property_add_child(obj, "a", *a, &error_abort);
+    object_property_add_child(*a, "b", *b, &error_abort);
+    object_unref(*a);
+    object_unref(*b);
+
+    return obj;
+}
+
+static void test_containers(void)
+{
+    Object *root = object_get_root();
+    Object *peripheral = container_get(root, "machine/peripheral");
+
+    assert_path(root, "/");
+    assert_path(peripheral, "/machine/peripheral");
+    assert_path(object_resolve_path("/machine"), "/machine");
+    g_assert(container_get(root, "machine/peripheral") == peripheral);
+    g_assert(object_resolve_path_component(object_resolve_path("/machine"),
+                                           "peripheral") == peripheral);
+}
+
+static void test_attach_detach(void)
+{
+    Object *peripheral = container_get(object_get_root(),
+                                       "machine/peripheral");
+    Object *obj, *a, *b;
+
+    /* A detached subtree has no paths... */
+    obj = test_tree_new(&a, &b);
+    assert_path(obj, NULL);
+    assert_path(b, NULL);
+
+    /* ...until it is attached, with all its descendants. */
+    object_property_add_child(peripheral, "dev", obj, &error_abort);
+    assert_path(obj, "/machine/peripheral/dev");
+    assert_path(a, "/machine/peripheral/dev/a");
+    assert_path(b, "/machine/peripheral/dev/a/b");
+
+    /* Children added below an attached object are indexed too. */
+    object_property_del(a, "b");
+    g_assert(object_resolve_path("/machine/peripheral/dev/a/b") == NULL);
+    b = object_new(TYPE_TEST_OBJECT);
+    object_property_add_child(a, "c", b, &error_abort);
+    object_unref(b);
+    assert_path(b, "/machine/peripheral/dev/a/c");
+
+    /* Unparenting drops the paths of the whole subtree. */
+    test_unparented = 0;
+    object_unparent(obj);
+    g_assert_cmpint(test_unparented, ==, 1);
+    g_assert(obj->parent == NULL);
+    assert_path(obj, NULL);
+    assert_path(a, NULL);
+    assert_path(b, NULL);
+    g_assert(object_resolve_path("/machine/peripheral/dev") == NULL);
+    g_assert(object_resolve_path("/machine/peripheral/dev/a/c") == NULL);
+
+    /* It can be attached again under another name. */
+    object_property_add_child(peripheral, "dev2", obj, &error_abort);
+    assert_path(b, "/machine/peripheral/dev2/a/c");
+
+    /* Finalizing the subtree unindexes it as well. */
+    object_unref(obj);
+    object_unparent(obj);
+    g_assert(object_resolve_path("/machine/peripheral/dev2") == NULL);
+    g_assert(object_resolve_path("/machine/peripheral/dev2/a/c") == NULL);
+}
+
+static void test_links(void)
+{
+    Object *peripheral = container_get(object_get_root(),
+                                       "machine/peripheral");
+    Object *obj = object_new(TYPE_TEST_OBJECT);
+    Object *target = object_new(TYPE_TEST_OBJECT);
+
+    object_property_add_child(peripheral, "owner", obj, &error_abort);
+    object_property_add_link(obj, "target", target, &error_abort);
+
+    /* Links are not part of the tree. */
+    g_assert(object_resolve_path_component(obj, "target") == target);
+    g_assert(target->parent == NULL);
+    assert_path(target, NULL);
+    g_assert(object_resolve_path("/machine/peripheral/owner/target") == NULL);
+
+    object_unparent(obj);
+    object_unref(obj);
+    object_unref(target);
+}
+
+static void test_errors(void)
+{
+    Object *obj, *a, *b;
+    Object *other = object_new(TYPE_TEST_OBJECT);
+    Error *err = NULL;
+
+    obj = test_tree_new(&a, &b);
+
+    object_property_add_child(obj, "x/y", other, &err);
+    g_assert(err != NULL);
+    error_free(err);
+    err = NULL;
+
+    object_property_add_child(obj, "a", other, &err);
+    g_assert(err != NULL);
+    error_free(err);
+    err = NULL;
+
+    object_property_add_child(other, "b", b, &err);
+    g_assert(err != NULL);
+    error_free(err);
+    err = NULL;
+
+    object_property_add_child(b, "loop", obj, &err);
+    g_assert(err != NULL);
+    error_free(err);
+
+    g_assert(other->parent == NULL);
+    g_assert(b->parent == a);
+
+    object_unref(obj);
+    object_unref(other);
+}
+
+int main(void)
+{
+    object_type_register();
+    type_register_static(&test_object_info);
+
+    test_containers();
+    test_attach_detach();
+    test_links();
+    test_errors();
+
+    return 0;
+}
@@ -0,0 +1,328 @@
+/*
+ * Tests for object_serialize() and object_deserialize()
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../qom/object.h"
+#include "../qom/serialize.h"
+
+#define TYPE_TEST_NODE "test-node"
+#define TYPE_TEST_DEVICE "test-device"
+
+typedef struct TestNode {
+    Object parent;
+
+    guint32 value;
+    char *label;
+    Object *peer;
+} TestNode;
+
+typedef struct TestDevice {
+    TestNode parent;
+
+    /* Created by instance_init as the child "bus". */
+    TestNode *bus;
+} TestDevice;
+
+#define TEST_NODE(obj) OBJECT_CHECK(TestNode, obj, TYPE_TEST_NODE)
+#define TEST_DEVICE(obj) OBJECT_CHECK(TestDevice, obj, TYPE_TEST_DEVICE)
+
+/* The offset of alloc_size in the stream header. */
+#define STREAM_ALLOC_SIZE 16
+
+static void test_node_finalize(Object *obj)
+{
+    TestNode *node = TEST_NODE(obj);
+
+    g_free(node->label);
+    if (node->peer) {
+        object_unref(node->peer);
+    }
+}
+
+static void test_node_save(Object *obj, ObjectWriter *w)
+{
+    TestNode *node = TEST_NODE(obj);
+
+    object_writer_put_u32(w, node->value);
+    object_writer_put_str(w, node->label);
+    object_writer_put_object(w, node->peer);
+}
+
+static bool test_node_load(Object *obj, ObjectReader *r, int version,
+                           Error **errp)
+{
+    TestNode *node = TEST_NODE(obj);
+
+    return object_reader_get_u32(r, &node->value) &&
+           object_reader_get_str(r, &node->label) &&
+           object_reader_get_object(r, &node->peer);
+}
+
+static void test_device_init(Object *obj)
+{
+    TestDevice *dev = TEST_DEVICE(obj);
+
+    dev->bus = TEST_NODE(object_new(TYPE_TEST_NODE));
+    object_property_add_child(obj, "bus", OBJECT(dev->bus), &error_abort);
+    object_unref(OBJECT(dev->bus));
+}
+
+static const TypeInfo test_node_info = {
+    .name = TYPE_TEST_NODE,
+    .parent = TYPE_OBJECT,
+    .instance_size = sizeof(TestNode),
+    .instance_finalize = test_node_finalize,
+    .version = 1,
+    .save = test_node_save,
+    .load = test_node_load,
+};
+
+static const TypeInfo test_device_info = {
+    .name = TYPE_TEST_DEVICE,
+    .parent = TYPE_TEST_NODE,
+    .instance_size = sizeof(TestDevice),
+    .instance_init = test_device_init,
+};
+
+static TestNode *test_node_new(guint32 value, const char *label)
+{
+    TestNode *node = TEST_NODE(object_new(TYPE_TEST_NODE));
+
+    node->value = value;
+    node->label = g_strdup(label);
+    return node;
+}
+
+static Object *round_trip(Object *obj)
+{
+    Object *copy;
+    size_t size;
+    void *buf;
+
+    buf = object_serialize(obj, &size);
+    copy = object_deserialize(buf, size, &error_abort);
+    g_free(buf);
+
+    return copy;
+}
+
+static void test_round_trip(void)
+{
+    TestNode *node = test_node_new(42, "node");
+    TestNode *copy = TEST_NODE(round_trip(OBJECT(node)));
+
+    g_assert(copy != node);
+    g_assert_cmpint(copy->value, ==, 42);
+    g_assert(!strcmp(copy->label, "node"));
+    g_assert(copy->peer == NULL);
+
+    object_unref(OBJECT(copy));
+    object_unref(OBJECT(node));
+}
+
+static void test_shared_references(void)
+{
+    TestNode *a = test_node_new(1, "a");
+    TestNode *b = test_node_new(2, NULL);
+    TestNode *copy;
+
+    /* a -> b -> b: the second reference must not save b again. */
+    a->peer = OBJECT(b);
+    object_ref(OBJECT(b));
+    b->peer = OBJECT(b);
+    object_ref(OBJECT(b));
+
+    copy = TEST_NODE(round_trip(OBJECT(a)));
+    g_assert(copy->peer != NULL && copy->peer != OBJECT(b));
+    g_assert(TEST_NODE(copy->peer)->peer == copy->peer);
+    g_assert_cmpint(TEST_NODE(copy->peer)->value, ==, 2);
+    g_assert(TEST_NODE(copy->peer)->label == NULL);
+
+    /* Break the cycles so that the objects can be finalized. */
+    object_unref(TEST_NODE(copy->peer)->peer);
+    TEST_NODE(copy->peer)->peer = NULL;
+    object_unref(OBJECT(copy));
+    object_unref(b->peer);
+    b->peer = NULL;
+    object_unref(OBJECT(a));
+    object_unref(OBJECT(b));
+}
+
+static void test_properties(void)
+{
+    TestDevice *dev = TEST_DEVICE(object_new(TYPE_TEST_DEVICE));
+    TestNode *extra = test_node_new(7, "extra");
+    TestDevice *copy;
+    Object *child;
+
+    dev->bus->value = 5;
+    object_property_add_child(OBJECT(dev), "extra", OBJECT(extra),
+                              &error_abort);
+    object_property_add_link(OBJECT(dev), "primary", OBJECT(dev->bus),
+                             &error_abort);
+    object_property_add_link(OBJECT(extra), "owner", OBJECT(dev->bus),
+                             &error_abort);
+
+    copy = TEST_DEVICE(round_trip(OBJECT(dev)));
+
+    /* The child instance_init created is restored in place. */
+    g_assert(object_resolve_path_component(OBJECT(copy), "bus") ==
+             OBJECT(copy->bus));
+    g_assert_cmpint(copy->bus->value, ==, 5);
+    g_assert(OBJECT(copy->bus)->parent == OBJECT(copy));
+
+    child = object_resolve_path_component(OBJECT(copy), "extra");
+    g_assert(child != NULL && child != OBJECT(extra));
+    g_assert(child->parent == OBJECT(copy));
+    g_assert_cmpint(TEST_NODE(child)->value, ==, 7);
+    g_assert(!strcmp(TEST_NODE(child)->label, "extra"));
+
+    g_assert(object_resolve_path_component(OBJECT(copy), "primary") ==
+             OBJECT(copy->bus));
+    g_assert(object_resolve_path_component(child, "owner") ==
+             OBJECT(copy->bus));
+
+    object_unref(OBJECT(copy));
+    object_unref(OBJECT(extra));
+    object_unref(OBJECT(dev));
+}
+
+static void test_detached_root(void)
+{
+    Object *parent = object_new(TYPE_TEST_DEVICE);
+    TestNode *node = test_node_new(3, "node");
+    Object *copy;
+
+    object_property_add_child(parent, "node", OBJECT(node), &error_abort);
+
+    copy = round_trip(OBJECT(node));
+    g_assert(copy->parent == NULL);
+    g_assert_cmpint(TEST_NODE(copy)->value, ==, 3);
+
+    object_unref(copy);
+    object_unref(OBJECT(node));
+    object_unref(parent);
+}
+
+static void expect_failure(const void *buf, size_t size)
+{
+    Error *err = NULL;
+
+    g_assert(object_deserialize(buf, size, &err) == NULL);
+    g_assert(err != NULL);
+    error_free(err);
+}
+
+/* A tree without links, so that corrupting a reference cannot make the
+ * restored graph cyclic.
+ */
+static void *serialize_tree(size_t *size)
+{
+    TestDevice *dev = TEST_DEVICE(object_new(TYPE_TEST_DEVICE));
+    TestNode *extra = test_node_new(7, "extra");
+    void *buf;
+
+    object_property_add_child(OBJECT(dev), "extra", OBJECT(extra),
+                              &error_abort);
+    object_unref(OBJECT(extra));
+
+    buf = object_serialize(OBJECT(dev), size);
+    object_unref(OBJECT(dev));
+
+    return buf;
+}
+
+static void test_truncated(void)
+{
+    size_t size, len;
+    char *buf = serialize_tree(&size);
+
+    for (len = 0; len < size; len++) {
+        expect_failure(buf, len);
+    }
+
+    g_free(buf);
+}
+
+static void test_alloc_size(void)
+{
+    static const guint64 bad[] = {
+        ~(guint64)0 & ~(guint64)15,   /* wraps around with the header */
+        (guint64)1 << 62,             /* cannot be allocated */
+        (guint64)1 << 32,             /* more than the objects can use */
+        24,                           /* not a multiple of the alignment */
+    };
+    size_t size, i;
+    char *buf = serialize_tree(&size);
+    guint64 alloc_size;
+    Object *obj;
+
+    for (i = 0; i < G_N_ELEMENTS(bad); i++) {
+        alloc_size = bad[i];
+        memcpy(buf + STREAM_ALLOC_SIZE, &alloc_size, sizeof(alloc_size));
+        expect_failure(buf, size);
+    }
+
+    /* Objects that do not fit the block get their own allocation. */
+    alloc_size = 0;
+    memcpy(buf + STREAM_ALLOC_SIZE, &alloc_size, sizeof(alloc_size));
+    obj = object_deserialize(buf, size, &error_abort);
+    g_assert(object_resolve_path_component(obj, "extra") != NULL);
+    object_unref(obj);
+
+    g_free(buf);
+}
+
+static void test_corrupted(void)
+{
+    size_t size, i;
+    char *buf = serialize_tree(&size);
+    char *copy = g_malloc(size);
+    Error *err = NULL;
+    Object *obj;
+    int bit;
+
+    /* Whatever a flipped bit turns the stream into, loading it fails
+     * cleanly or yields an object that can be freed.
+     */
+    for (i = 0; i < size; i++) {
+        for (bit = 0; bit < 8; bit++) {
+            memcpy(copy, buf, size);
+            copy[i] ^= 1 << bit;
+            obj = object_deserialize(copy, size, &err);
+            if (obj) {
+                g_assert(err == NULL);
+                object_unref(obj);
+            } else {
+                g_assert(err != NULL);
+                error_free(err);
+                err = NULL;
+            }
+        }
+    }
+
+    g_free(copy);
+    g_free(buf);
+}
+
+int main(void)
+{
+    object_type_register();
+    type_register_static(&test_node_info);
+    type_register_static(&test_device_info);
+
+    test_round_trip();
+    test_shared_references();
+    test_properties();
+    test_detached_root();
+    test_truncated();
+    test_alloc_size();
+    test_corrupted();
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * Tests for weak references
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "../qom/object.h"
+
+#define TYPE_TEST_OBJECT "test-object"
+
+static int test_finalized;
+
+static void test_object_finalize(Object *obj)
+{
+    test_finalized++;
+}
+
+static const TypeInfo test_object_info = {
+    .name = TYPE_TEST_OBJECT,
+    .parent = TYPE_OBJECT,
+    .instance_size = sizeof(Object),
+    .instance_finalize = test_object_finalize,
+};
+
+static void test_get(void)
+{
+    Object *obj = object_new(TYPE_TEST_OBJECT);
+    ObjectWeakRef wr;
+    Object *ref;
+
+    object_weak_ref_init(&wr, obj);
+    ref = object_weak_ref_get(&wr);
+    g_assert(ref == obj);
+    object_unref(ref);
+
+    /* The weak reference does not keep the object alive. */
+    test_finalized = 0;
+    object_unref(obj);
+    g_assert_cmpint(test_finalized, ==, 1);
+    g_assert(object_weak_ref_get(&wr) == NULL);
+
+    object_weak_ref_clear(&wr);
+}
+
+static void test_cleared_on_finalize(void)
+{
+    Object *obj = object_new(TYPE_TEST_OBJECT);
+    ObjectWeakRef wr[3];
+    int i;
+
+    for (i = 0; i < G_N_ELEMENTS(wr); i++) {
+        object_weak_ref_init(&wr[i], obj);
+    }
+    object_unref(obj);
+
+    for (i = 0; i < G_N_ELEMENTS(wr); i++) {
+        g_assert(object_weak_ref_get(&wr[i]) == NULL);
+        object_weak_ref_clear(&wr[i]);
+    }
+}
+
+static void test_set(void)
+{
+    Object *a = object_new(TYPE_TEST_OBJECT);
+    Object *b = object_new(TYPE_TEST_OBJECT);
+    ObjectWeakRef wr;
+    Object *ref;
+
+    object_weak_ref_init(&wr, a);
+    object_weak_ref_set(&wr, b);
+
+    /* Finalizing the old target leaves the weak reference alone. */
+    object_unref(a);
+    ref = object_weak_ref_get(&wr);
+    g_assert(ref == b);
+    object_unref(ref);
+
+    object_weak_ref_set(&wr, NULL);
+    g_assert(object_weak_ref_get(&wr) == NULL);
+
+    object_weak_ref_clear(&wr);
+    object_unref(b);
+}
+
+static void test_clear(void)
+{
+    Object *obj = object_new(TYPE_TEST_OBJECT);
+    ObjectWeakRef *wr = g_new(ObjectWeakRef, 1);
+
+    /* A cleared weak reference can be freed before its object. */
+    object_weak_ref_init(wr, obj);
+    object_weak_ref_clear(wr);
+    g_free(wr);
+
+    test_finalized = 0;
+    object_unref(obj);
+    g_assert_cmpint(test_finalized, ==, 1);
+}
+
+static void test_deferred_finalize(void)
+{
+    Object *obj = object_new(TYPE_TEST_OBJECT);
+    ObjectWeakRef wr;
+
+    object_weak_ref_init(&wr, obj);
+    object_set_deferred_finalize(true);
+
+    /* A queued object is out of reach before it is finalized. */
+    test_finalized = 0;
+    object_unref(obj);
+    g_assert_cmpint(test_finalized, ==, 0);
+    g_assert(object_weak_ref_get(&wr) == NULL);
+
+    g_assert_cmpint(object_reclaim(), ==, 1);
+    g_assert_cmpint(test_finalized, ==, 1);
+    g_assert(object_weak_ref_get(&wr) == NULL);
+
+    object_set_deferred_finalize(false);
+    object_weak_ref_clear(&wr);
+}
+
+int main(void)
+{
+    object_type_register();
+    type_register_static(&test_object_info);
+
+    test_get();
+    test_cleared_on_finalize();
+    test_set();
+    test_clear();
+    test_deferred_finalize();
+
+    return 0;
+}